@@ -0,0 +1,368 @@
+/*
+ * anim.c
+ * delta encoded animations from disk or attic RAM
+ *
+ * Copyright (C) 2019-21 - Stephan Kleinert
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+how it works:
+
+an fca file (written by png2fci -a) is an fci header with frame delay
+and frame count, the palette, a keyframe and one delta per frame. the
+keyframe is shown like an fci image, every cell with its own character
+("slot"). a delta first points screen cells at other slots, then
+overwrites slots with new character data:
+
+    word swaps, word writes
+    swaps  x (byte column, byte row, word slot)
+    writes x (word slot, 64 bytes character data)
+
+after the delta to the last frame comes one back to the first, so
+looping just continues with the delta to frame 1.
+
+a raster handler in the vertical blank applies the next delta when
+the frame delay has passed, straight from attic RAM with DMA. loaded
+animations are walked through there in place; streamed ones have
+the next delta read into a staging area by fc_animUpdate, which is
+called from the main program because the KERNAL can't be used in the
+interrupt.
+*/
+
+#include "fcio.h"
+#include "hwmath.h"
+#include "memory.h"
+#include <stdio.h>
+#include <string.h>
+
+#define FCA_HEADER 12
+#define FCA_VERSION 1
+#define DELTA_HEADER 4
+#define SWAP_SIZE 4
+#define WRITE_SIZE 66
+
+extern int gBottomBorder;
+
+static FILE *animFile; // open while streaming
+static char animName[17];
+static long deltaSkip; // file offset of the delta to frame 1
+
+static bool installed;
+static bool animOpen;
+static bool streaming;
+static himemPtr charBase;  // slots in graphic memory
+static word firstChar;     // character number of slot 0
+static himemPtr screenAdr; // top left cell
+static word rowBytes;
+static word frameCount;
+static word nextRead;      // streaming: frame the next delta in the file leads to
+
+static volatile bool playing;
+static volatile bool looping;
+static volatile bool frameReady;   // frameAdr holds the next delta
+static volatile himemPtr frameAdr;
+static volatile word shown;        // frame on screen
+static volatile byte delay;
+static byte delayCount;
+
+static const byte fcaMagic[] = {0x66, 0x63, 0x61, 0x50}; // "fcaP" in ASCII
+
+// read count bytes into far memory (or skip them if dst is 0)
+static bool readBlock(himemPtr dst, long count)
+{
+    static byte n;
+
+    while (count > 0)
+    {
+        n = count > FCBUFSIZE ? FCBUFSIZE : count;
+        if (fread(fcbuf, 1, n, animFile) != n)
+        {
+            return false;
+        }
+        if (dst)
+        {
+            lcopy((long)fcbuf, dst, n);
+            dst += n;
+        }
+        count -= n;
+    }
+    return true;
+}
+
+// read the rest of the file into far memory, false if it's more than max bytes
+static bool readRest(himemPtr dst, long max)
+{
+    static byte n;
+    long count;
+
+    count = 0;
+    do
+    {
+        n = fread(fcbuf, 1, FCBUFSIZE, animFile);
+        count += n;
+        if (count > max)
+        {
+            return false;
+        }
+        if (n)
+        {
+            lcopy((long)fcbuf, dst, n);
+            dst += n;
+        }
+    } while (n);
+    return true;
+}
+
+// apply delta, return address behind it
+static himemPtr applyDelta(himemPtr adr)
+{
+    static byte entry[DELTA_HEADER];
+    static word swaps, writes, idx;
+    static himemPtr cell;
+
+    lcopy(adr, (long)entry, DELTA_HEADER);
+    swaps = entry[0] | (entry[1] << 8);
+    writes = entry[2] | (entry[3] << 8);
+    adr += DELTA_HEADER;
+
+    for (; swaps; --swaps)
+    {
+        lcopy(adr, (long)entry, SWAP_SIZE);
+        cell = screenAdr + (entry[1] * rowBytes) + (entry[0] * 2);
+        idx = firstChar + (entry[2] | (entry[3] << 8));
+        entry[2] = idx & 0xff;
+        entry[3] = idx >> 8;
+        lcopy((long)entry + 2, cell, 2);
+        adr += SWAP_SIZE;
+    }
+    for (; writes; --writes)
+    {
+        lcopy(adr, (long)entry, 2);
+        lcopy(adr + 2, charBase + ((himemPtr)(entry[0] | (entry[1] << 8)) * 64), 64);
+        adr += WRITE_SIZE;
+    }
+    return adr;
+}
+
+static void animFrame(void)
+{
+    static himemPtr next;
+
+    if (!playing)
+    {
+        return;
+    }
+    if (delayCount < delay)
+    {
+        delayCount++;
+    }
+    if (delayCount < delay || !frameReady)
+    {
+        return;
+    }
+    delayCount = 0;
+    next = applyDelta(frameAdr);
+    shown = shown + 1 == frameCount ? 0 : shown + 1;
+
+    if (streaming)
+    {
+        frameReady = false;
+    }
+    else
+    {
+        // the delta back to frame 0 is followed by the end of the file
+        frameAdr = shown == 0 ? ANIMBASE : next;
+    }
+    if (shown == frameCount - 1 && !looping)
+    {
+        playing = false;
+    }
+}
+
+static bool reopen(void)
+{
+    fclose(animFile);
+    animFile = fopen(animName, "rb");
+    return animFile && readBlock(0, deltaSkip);
+}
+
+bool fc_animOpen(char *filename, bool stream, byte x0, byte y0)
+{
+    static byte rows, columns, options, numColours;
+    word slots;
+
+    fc_animClose();
+    animFile = fopen(filename, "rb");
+    if (!animFile)
+    {
+        return false;
+    }
+    if (fread(fcbuf, 1, FCA_HEADER, animFile) != FCA_HEADER ||
+        0 != memcmp(fcbuf, fcaMagic, sizeof(fcaMagic)) || fcbuf[4] != FCA_VERSION)
+    {
+        fc_animClose();
+        return false;
+    }
+    rows = fcbuf[5];
+    columns = fcbuf[6];
+    options = fcbuf[7];
+    numColours = fcbuf[8];
+    delay = fcbuf[9];
+    frameCount = fcbuf[10] | (fcbuf[11] << 8);
+    slots = rows * columns;
+
+    // the palette goes through the staging area
+    if (!readBlock(ANIMSTAGE, numColours * 3) || fread(fcbuf, 1, 3, animFile) != 3 ||
+        0 != memcmp(fcbuf, "img", 3) || slots > 0xffff / 64)
+    {
+        fc_animClose();
+        return false;
+    }
+    charBase = fc_allocGraphMem(slots * 64);
+    if (charBase == 0 || !readBlock(charBase, slots * 64))
+    {
+        fc_animClose();
+        return false;
+    }
+    deltaSkip = FCA_HEADER + (numColours * 3) + 3 + ((long)slots * 64);
+
+    streaming = stream;
+    if (!stream)
+    {
+        if (!readRest(ANIMBASE, ANIMSIZE))
+        {
+            fc_animClose();
+            return false;
+        }
+        fclose(animFile);
+        animFile = NULL;
+    }
+    else
+    {
+        strncpy(animName, filename, sizeof(animName) - 1);
+        nextRead = frameCount > 1 ? 1 : 0;
+    }
+    mega65_io_enable(); // kernal has the disgusting habit of resetting vic personality
+
+    fc_loadPalette(ANIMSTAGE, numColours, options & 2);
+    if (options & 4)
+    {
+        fc_addNCMGraphicsRect(x0, y0, columns, rows, charBase, (options & 2) ? 1 : 0);
+    }
+    else
+    {
+        fc_addGraphicsRect(x0, y0, columns, rows, charBase);
+    }
+    firstChar = charBase / 64;
+    screenAdr = gScreenBase + cellOffset(x0, y0);
+    rowBytes = gScreenRowBytes;
+
+    playing = false;
+    frameReady = false;
+    frameAdr = ANIMBASE;
+    shown = 0;
+    animOpen = true;
+    if (!installed)
+    {
+        fc_addRasterHandler((gBottomBorder / 2) + 2, animFrame);
+        installed = true;
+    }
+    return true;
+}
+
+void fc_animPlay(bool loop)
+{
+    if (!animOpen || (shown == frameCount - 1 && !loop))
+    {
+        return;
+    }
+    looping = loop;
+    delayCount = 0;
+    if (!streaming)
+    {
+        frameReady = true;
+    }
+    playing = true;
+    fc_animUpdate();
+}
+
+bool fc_animUpdate(void)
+{
+    static byte head[DELTA_HEADER];
+    long size;
+
+    if (!playing || !streaming || !animFile || frameReady)
+    {
+        return playing;
+    }
+    if (nextRead == 0 && !looping)
+    {
+        // the delta back to frame 0 isn't needed
+        return playing;
+    }
+
+    if (fread(head, 1, DELTA_HEADER, animFile) != DELTA_HEADER)
+    {
+        fc_animStop();
+        return false;
+    }
+    size = DELTA_HEADER + ((long)(head[0] | (head[1] << 8)) * SWAP_SIZE) +
+           ((long)(head[2] | (head[3] << 8)) * WRITE_SIZE);
+    if (size > ANIMSTAGESIZE)
+    {
+        fc_fatal("anim frame too big");
+    }
+    lcopy((long)head, ANIMSTAGE, DELTA_HEADER);
+    if (!readBlock(ANIMSTAGE + DELTA_HEADER, size - DELTA_HEADER))
+    {
+        fc_animStop();
+        return false;
+    }
+
+    if (nextRead == 0 && !reopen())
+    {
+        fc_animStop();
+        return false;
+    }
+    nextRead = nextRead + 1 == frameCount ? 0 : nextRead + 1;
+    mega65_io_enable();
+
+    frameAdr = ANIMSTAGE;
+    frameReady = true;
+    return playing;
+}
+
+void fc_animStop(void)
+{
+    playing = false;
+}
+
+void fc_animSetDelay(byte vblanks)
+{
+    delay = vblanks ? vblanks : 1;
+}
+
+void fc_animClose(void)
+{
+    playing = false;
+    frameReady = false;
+    animOpen = false;
+    if (animFile)
+    {
+        fclose(animFile);
+        animFile = NULL;
+    }
+}
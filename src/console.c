@@ -0,0 +1,169 @@
+/*
+ * console.c
+ * virtual consoles with their own screen and colour memory
+ *
+ * Copyright (C) 2019-21 - Stephan Kleinert
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+how it works:
+
+console 0 is the normal screen. every other console gets a screen of
+the same size in graphic memory and the colour RAM right behind the
+console before it, as many as fit below COLOUR_RAM_END. all fcio
+output goes through gScreenBase and gColourBase, so fc_selectConsole
+only has to point those (and gCurrentWin) at a console to draw into
+it, whether it's visible or not.
+
+fc_switchConsole queues one deferred call that writes the new screen
+and colour pointers, so the VIC picks them up together in the next
+vertical blank.
+*/
+
+#include "fcio.h"
+#include "memory.h"
+#include "vic4.h"
+#include <6502.h>
+
+#define MAX_CONSOLES 4
+#define COLOUR_RAM_END 0xff88000l // colour RAM is 32K
+
+typedef struct _console
+{
+    himemPtr screen;  ///< screen memory
+    himemPtr colour;  ///< colour memory
+    textwin win;      ///< full screen window of this console
+    textwin *current; ///< window to use when the console is selected
+} console;
+
+static console consoles[MAX_CONSOLES];
+static byte consoleCount;
+static byte selected;
+static byte visible;
+
+// pointer values for switchPointers
+static byte nextScn0, nextScn1, nextScn2;
+static byte nextColLo, nextColHi;
+
+static void switchPointers(void)
+{
+    SCNPTR_0 = nextScn0;
+    SCNPTR_1 = nextScn1;
+    SCNPTR_2 = nextScn2;
+    COLPTR_LO = nextColLo;
+    COLPTR_HI = nextColHi;
+}
+
+byte fc_initConsoles(byte count)
+{
+    static byte n;
+    console *c;
+    word size;
+
+    if (consoleCount)
+    {
+        return consoleCount;
+    }
+    if (count > MAX_CONSOLES)
+    {
+        count = MAX_CONSOLES;
+    }
+
+    c = &consoles[0];
+    c->screen = gScreenBase;
+    c->colour = gColourBase;
+    c->win = *gCurrentWin;
+    c->current = gCurrentWin;
+    consoleCount = 1;
+    selected = 0;
+    visible = 0;
+
+    // one more row for smooth scrolling
+    size = gScreenRowBytes * (gScreenRows + 1);
+    for (n = 1; n < count; ++n)
+    {
+        c = &consoles[n];
+        c->colour = COLBASE + ((himemPtr)n * size);
+        if (c->colour + size > COLOUR_RAM_END)
+        {
+            break;
+        }
+        c->screen = fc_allocGraphMem(size);
+        if (c->screen == 0)
+        {
+            break;
+        }
+        c->win.x0 = 0;
+        c->win.y0 = 0;
+        c->win.width = gScreenColumns;
+        c->win.height = gScreenRows;
+        c->win.xc = 0;
+        c->win.yc = 0;
+        c->win.textcolor = gCurrentWin->textcolor;
+        c->win.extAttributes = 0;
+        c->current = &c->win;
+        lfill_skip(c->screen, 32, size / 2, 2);
+        lfill_skip(c->screen + 1, 0, size / 2, 2);
+        lfill_skip(c->colour, 0, size / 2, 2);
+        lfill_skip(c->colour + 1, c->win.textcolor, size / 2, 2);
+        consoleCount++;
+    }
+    return consoleCount;
+}
+
+void fc_selectConsole(byte n)
+{
+    console *c;
+
+    if (n >= consoleCount)
+    {
+        return;
+    }
+    consoles[selected].current = gCurrentWin;
+    c = &consoles[n];
+    gScreenBase = c->screen;
+    gColourBase = c->colour;
+    gCurrentWin = c->current;
+    selected = n;
+}
+
+void fc_switchConsole(byte n)
+{
+    console *c;
+    word colOfs;
+
+    if (n >= consoleCount || n == visible)
+    {
+        return;
+    }
+    c = &consoles[n];
+    colOfs = c->colour - 0xff80000l;
+    // a call from an earlier switch may still be queued, it picks up these
+    SEI();
+    nextScn0 = c->screen & 0xff;
+    nextScn1 = (c->screen >> 8) & 0xff;
+    nextScn2 = (c->screen >> 16) & 0xff;
+    nextColLo = colOfs & 0xff;
+    nextColHi = colOfs >> 8;
+    CLI();
+    fc_deferCall(switchPointers);
+    visible = n;
+}
+
+byte fc_visibleConsole(void)
+{
+    return visible;
+}
@@ -1,17 +1,7 @@
 #include <stdlib.h>
 #include <stdio.h>
-#include <time.h>
 #include "fcio.h"
 
-void jiffySleep(int num)
-{
-    unsigned int t;
-
-    t = clock();
-    while ((clock() - t) < num)
-        ;
-}
-
 void main(void)
 {
     char i;
@@ -22,10 +12,16 @@ void main(void)
     
     fc_textcolor(8);                  // orange
 
+#ifdef MATHBENCH
+    fc_mathBenchmark();
+    fc_getkey();
+    fc_clrscr();
+#endif
+
     img0 = fc_loadFCI("once.fci", 0, 0);         // load title image
     fc_center(0, 25, 40, "once upon a time..."); // display prompt at lower center
     fc_fadeFCI(img0, 0, 0, 128);                 // fade in title image
-    jiffySleep(60);
+    fc_waitFrames(60);
 
     // we can easily scroll graphic areas...
     w0 = fc_makeWin(0, 0, 20, 25);
@@ -36,24 +32,29 @@ void main(void)
         fc_scrollDown();
         fc_setwin(w1);
         fc_scrollUp();
-        jiffySleep(3);
+        fc_waitFrames(3);
     }
 
-    jiffySleep(60);
+    // ...or smoothly move the whole screen
+    fc_smoothScroll(64, 2);
+    while (fc_smoothScrolling())
+        fc_waitVBlank();
+
+    fc_waitFrames(60);
     fc_screenmode(1, 0, 26); // activate H640 with 26 rows
     fc_freeGraphAreas();
     fc_textcolor(15);
     fc_center(0, 12, 80, "\"Horses fly without wings,");
     fc_center(0, 13, 80, " and conquer without swords\"");
     fc_center(0, 15, 80, "       -- Bedouin proverb");
-    jiffySleep(60);
+    fc_waitFrames(60);
 
     // load a few files and display them directly
     fc_displayFCIFile("lucky1.fci", 0, 0);
     fc_displayFCIFile("luna.fci", 55, 14);
     fc_displayFCIFile("scarlett.fci", 0, 14);
     img0 = fc_displayFCIFile("lsc.fci", 50, 0);
-    jiffySleep(120);
+    fc_waitFrames(120);
 
     fc_fadePalette(img0->paletteAdr, img0->paletteSize, true, 128, true);
     fc_freeGraphAreas();
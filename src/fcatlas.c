@@ -0,0 +1,141 @@
+/*
+ * fcatlas.c
+ * runtime allocation of extended (full colour) characters
+ *
+ * Copyright (C) 2019-21 - Stephan Kleinert
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+the atlas is a fixed block of ATLASSLOTS 64 byte character slots at
+the top of chip RAM. every slot has a reference count (0 == free) and
+the hash of its contents, so adding a glyph which is already there only
+bumps the count of the existing slot.
+*/
+
+#include "fcio.h"
+#include "memory.h"
+#include <string.h>
+
+#define MAXREFS 0xffff
+
+static word atlasRefs[ATLASSLOTS];  // reference counts, 0 == free
+static word atlasHash[ATLASSLOTS];  // hash of slot contents
+
+static word glyphHash(const byte *glyph)
+{
+    static byte i;
+    word h;
+
+    h = 0;
+    for (i = 0; i < 64; ++i)
+    {
+        h = ((h << 1) | (h >> 15)) ^ glyph[i];
+    }
+    return h;
+}
+
+static word slotChar(byte slot)
+{
+    return (ATLASBASE / 64) + slot;
+}
+
+// slot of an atlas character in use, or false
+static bool usedSlot(word charIdx, byte *slot)
+{
+    if (charIdx < (ATLASBASE / 64) || charIdx >= (ATLASBASE / 64) + ATLASSLOTS)
+    {
+        return false;
+    }
+    *slot = charIdx - (ATLASBASE / 64);
+    return atlasRefs[*slot] != 0;
+}
+
+word fc_atlasAdd(const byte *glyph)
+{
+    static byte slot, freeSlot;
+    static bool haveFree;
+    word h;
+
+    h = glyphHash(glyph);
+    haveFree = false;
+    slot = 0;
+    do
+    {
+        if (atlasRefs[slot])
+        {
+            if (atlasHash[slot] == h && atlasRefs[slot] < MAXREFS)
+            {
+                lcopy(ATLASBASE + (slot * 64l), (long)fcbuf, 64);
+                if (!memcmp(fcbuf, glyph, 64))
+                {
+                    atlasRefs[slot]++;
+                    return slotChar(slot);
+                }
+            }
+        }
+        else if (!haveFree)
+        {
+            haveFree = true;
+            freeSlot = slot;
+        }
+    } while (++slot != (byte)ATLASSLOTS);
+
+    if (!haveFree)
+    {
+        return 0;
+    }
+    lcopy((long)glyph, ATLASBASE + (freeSlot * 64l), 64);
+    atlasHash[freeSlot] = h;
+    atlasRefs[freeSlot] = 1;
+    return slotChar(freeSlot);
+}
+
+bool fc_atlasRetain(word charIdx)
+{
+    static byte slot;
+    if (!usedSlot(charIdx, &slot) || atlasRefs[slot] == MAXREFS)
+    {
+        return false;
+    }
+    atlasRefs[slot]++;
+    return true;
+}
+
+void fc_atlasRelease(word charIdx)
+{
+    static byte slot;
+    if (usedSlot(charIdx, &slot))
+    {
+        atlasRefs[slot]--;
+    }
+}
+
+word fc_atlasFree(void)
+{
+    static byte slot;
+    word count;
+
+    count = 0;
+    slot = 0;
+    do
+    {
+        if (!atlasRefs[slot])
+        {
+            count++;
+        }
+    } while (++slot != (byte)ATLASSLOTS);
+    return count;
+}
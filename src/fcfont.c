@@ -0,0 +1,570 @@
+/*
+ * fcfont.c
+ * proportional anti-aliased fonts rendered into full colour characters
+ *
+ * Copyright (C) 2019-21 - Stephan Kleinert
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+fcf file layout (written by tools/png2fcf.py):
+
+  'FCF', version, height, first char, number of glyphs, levels,
+  number of kerning pairs, glyph widths, glyph pixels (height rows of
+  width bytes each, 0=background ... levels-1=full ink),
+  kerning pairs (left, right, signed adjustment)
+
+character codes in fcf files are ascii, strings are petscii.
+
+a string is rendered as one run of FCM characters (one character row
+high) into graphic memory. runs are kept in a small cache, so showing
+the same string in the same colours again only costs placing the
+characters on screen.
+
+fc_putText remembers where it placed each run. a run's characters are
+only reused for another string when none of its places still shows
+one of them, which is checked on the screen itself, so whatever
+overwrote the text, the run is free again. the characters of a
+replaced run that are too small for the new string are kept as a
+spare for a later one, graphic memory is never dropped.
+*/
+
+#include "fcio.h"
+#include "hwmath.h"
+#include "memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RUNCACHE_SIZE 32
+#define MAX_PLACED 48
+#define NO_RUN 0xff
+#define RENDER_CELLS 3 // characters rendered per pass (FCBUFSIZE / 64)
+
+typedef struct _glyphRun
+{
+    char *text;        ///< rendered string (NULL if entry unused)
+    fcFont *font;      ///< font used
+    byte bg, fg;       ///< colours used
+    byte generation;   ///< graphic memory generation of adr
+    byte cells;        ///< number of characters
+    byte capacity;     ///< number of characters allocated at adr
+    himemPtr adr;      ///< rendered characters
+    word lastUse;      ///< for lru replacement
+} glyphRun;
+
+typedef struct _placedRun
+{
+    himemPtr scr;      ///< screen address of the first character
+    byte run;          ///< runCache index + 1 (0 if entry unused)
+    byte cells;        ///< number of characters
+    byte generation;   ///< graphic memory generation when placed
+} placedRun;
+
+typedef struct _spareChars
+{
+    himemPtr adr;      ///< characters (0 if entry unused)
+    byte capacity;     ///< number of characters
+    byte generation;   ///< graphic memory generation of adr
+} spareChars;
+
+static glyphRun runCache[RUNCACHE_SIZE];
+static placedRun placed[MAX_PLACED];
+static spareChars spares[RUNCACHE_SIZE];
+static word runClock;
+static byte lastRun; // run returned by the last fc_renderText
+
+extern unsigned char nyblswap(unsigned char in);
+
+static byte petsciiToAscii(byte c)
+{
+    if (c >= 0x41 && c <= 0x5a)
+    {
+        return c + 0x20;
+    }
+    if (c >= 0xc1 && c <= 0xda)
+    {
+        return c - 0x80;
+    }
+    return c;
+}
+
+static signed char kerning(fcFont *f, byte left, byte right)
+{
+    static byte i;
+    signed char *k;
+
+    k = f->kern;
+    for (i = 0; i < f->numKern; ++i, k += 3)
+    {
+        if ((byte)k[0] == left && (byte)k[1] == right)
+        {
+            return k[2];
+        }
+    }
+    return 0;
+}
+
+// glyph index for ascii code, characters not in the font show the first glyph
+static byte glyphIndex(fcFont *f, byte c)
+{
+    if (c < f->firstChar || c >= f->firstChar + f->numChars)
+    {
+        return 0;
+    }
+    return c - f->firstChar;
+}
+
+fcFont *fc_loadFont(char *filename)
+{
+    static byte i;
+    FILE *fcffile;
+    fcFont *f;
+    word glyphSize;
+
+    fcffile = fopen(filename, "rb");
+    if (!fcffile)
+    {
+        fc_fatal("font not found %s", filename);
+    }
+    fread(fcbuf, 1, 9, fcffile);
+    if (0 != memcmp(fcbuf, "fcf", 3))
+    {
+        fc_fatal("no font: %s", filename);
+    }
+
+    f = (fcFont *)malloc(sizeof(fcFont));
+    f->height = fcbuf[4];
+    f->firstChar = fcbuf[5];
+    f->numChars = fcbuf[6];
+    f->levels = fcbuf[7];
+    f->numKern = fcbuf[8];
+    if (f->height > 8 || f->levels > 8)
+    {
+        fc_fatal("unsupported font %s", filename);
+    }
+
+    f->widths = (byte *)malloc(f->numChars);
+    f->offsets = (word *)malloc(f->numChars * sizeof(word));
+    fread(f->widths, 1, f->numChars, fcffile);
+
+    glyphSize = 0;
+    for (i = 0; i < f->numChars; ++i)
+    {
+        f->offsets[i] = glyphSize;
+        glyphSize += f->widths[i] * f->height;
+    }
+    f->glyphs = (byte *)malloc(glyphSize);
+    // malloc(0) returns NULL, so fonts without kerning pairs get none
+    f->kern = f->numKern ? (signed char *)malloc(f->numKern * 3) : NULL;
+    if (!f->glyphs || (f->numKern && !f->kern))
+    {
+        fc_fatal("no memory for %s", filename);
+    }
+    fread(f->glyphs, 1, glyphSize, fcffile);
+    fread(f->kern, 3, f->numKern, fcffile);
+    fclose(fcffile);
+
+    mega65_io_enable();
+    fc_fontColours(f, 0, 1);
+    return f;
+}
+
+void fc_freeFont(fcFont *f)
+{
+    static byte i;
+
+    for (i = 0; i < RUNCACHE_SIZE; ++i)
+    {
+        if (runCache[i].font == f && runCache[i].text)
+        {
+            free(runCache[i].text);
+            runCache[i].text = NULL;
+        }
+    }
+    free(f->kern);
+    free(f->glyphs);
+    free(f->offsets);
+    free(f->widths);
+    free(f);
+}
+
+void fc_fontColours(fcFont *f, byte bg, byte fg)
+{
+    static byte level, i, best;
+    static int r, g, b, dr, dg, db;
+    static byte br, bgr, bb, fr, fgr, fb;
+    long dist, bestDist;
+
+    f->bg = bg;
+    f->fg = fg;
+    f->ramp[0] = bg;
+    f->ramp[f->levels - 1] = fg;
+
+    br = nyblswap(PEEK(0xd100u + bg));
+    bgr = nyblswap(PEEK(0xd200u + bg));
+    bb = nyblswap(PEEK(0xd300u + bg));
+    fr = nyblswap(PEEK(0xd100u + fg));
+    fgr = nyblswap(PEEK(0xd200u + fg));
+    fb = nyblswap(PEEK(0xd300u + fg));
+
+    // in between: closest palette entries to the blended colours
+    for (level = 1; level < f->levels - 1; ++level)
+    {
+        r = br + ((fr - br) * level) / (f->levels - 1);
+        g = bgr + ((fgr - bgr) * level) / (f->levels - 1);
+        b = bb + ((fb - bb) * level) / (f->levels - 1);
+        bestDist = 0x7fffffffl;
+        best = fg;
+        i = 0;
+        do
+        {
+            dr = nyblswap(PEEK(0xd100u + i)) - r;
+            dg = nyblswap(PEEK(0xd200u + i)) - g;
+            db = nyblswap(PEEK(0xd300u + i)) - b;
+            dist = (long)dr * dr + (long)dg * dg + (long)db * db;
+            if (dist < bestDist)
+            {
+                bestDist = dist;
+                best = i;
+            }
+        } while (++i);
+        f->ramp[level] = best;
+    }
+}
+
+word fc_textWidth(fcFont *f, const char *s)
+{
+    int pen;
+    byte c, prev;
+
+    pen = 0;
+    prev = 0;
+    while (*s)
+    {
+        c = petsciiToAscii(*s++);
+        if (prev)
+        {
+            pen += kerning(f, prev, c);
+        }
+        pen += f->widths[glyphIndex(f, c)];
+        prev = c;
+    }
+    return pen < 0 ? 0 : pen;
+}
+
+// render the characters [first, first+count) of a run into fcbuf
+static void renderCells(fcFont *f, const char *s, byte first, byte count)
+{
+    static byte gx, gy, w, lvl, c, prev;
+    int pen, px, lo, hi;
+    byte *glyph;
+
+    memset(fcbuf, f->ramp[0], count * 64);
+    lo = first * 8;
+    hi = lo + (count * 8);
+    pen = 0;
+    prev = 0;
+
+    while (*s && pen < hi)
+    {
+        c = petsciiToAscii(*s++);
+        if (prev)
+        {
+            pen += kerning(f, prev, c);
+        }
+        prev = c;
+        c = glyphIndex(f, c);
+        w = f->widths[c];
+        if (pen + w > lo)
+        {
+            glyph = f->glyphs + f->offsets[c];
+            for (gx = 0; gx < w; ++gx)
+            {
+                px = pen + gx;
+                if (px < lo)
+                {
+                    continue;
+                }
+                if (px >= hi)
+                {
+                    break;
+                }
+                px -= lo;
+                for (gy = 0; gy < f->height; ++gy)
+                {
+                    lvl = glyph[gy * w + gx];
+                    if (lvl)
+                    {
+                        fcbuf[((px >> 3) * 64) + (gy * 8) + (px & 7)] = f->ramp[lvl];
+                    }
+                }
+            }
+        }
+        pen += w;
+    }
+}
+
+// does the screen still show one of the characters of a placement?
+static bool stillShown(placedRun *p)
+{
+    static byte i, n, done;
+    word idx;
+
+    if (p->generation != gGraphGeneration)
+    {
+        return false;
+    }
+    idx = runCache[p->run - 1].adr / 64;
+    for (done = 0; done < p->cells; done += n)
+    {
+        n = p->cells - done > FCBUFSIZE / 2 ? FCBUFSIZE / 2 : p->cells - done;
+        lcopy(p->scr + (done * 2), (long)fcbuf, n * 2);
+        for (i = 0; i < n; ++i, ++idx)
+        {
+            if ((byte)fcbuf[i * 2] == (idx & 0xff) && (byte)fcbuf[(i * 2) + 1] == (idx >> 8))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// is run r still on screen? forgets the places where it's gone
+static bool runShown(byte r)
+{
+    static byte i;
+    bool shown;
+
+    shown = false;
+    for (i = 0; i < MAX_PLACED; ++i)
+    {
+        if (placed[i].run == r + 1)
+        {
+            if (stillShown(&placed[i]))
+            {
+                shown = true;
+            }
+            else
+            {
+                placed[i].run = 0;
+            }
+        }
+    }
+    return shown;
+}
+
+static bool addPlacement(byte r, himemPtr scr, byte cells)
+{
+    static byte i, pass;
+
+    for (pass = 0; pass < 2; ++pass)
+    {
+        for (i = 0; i < MAX_PLACED; ++i)
+        {
+            if (!placed[i].run)
+            {
+                placed[i].scr = scr;
+                placed[i].run = r + 1;
+                placed[i].cells = cells;
+                placed[i].generation = gGraphGeneration;
+                return true;
+            }
+        }
+        // full: drop the places that have been overwritten
+        for (i = 0; i < MAX_PLACED; ++i)
+        {
+            if (!stillShown(&placed[i]))
+            {
+                placed[i].run = 0;
+            }
+        }
+    }
+    return false;
+}
+
+// entry for a new run of n characters: the best fitting one that isn't
+// on screen, else the least recently used one that isn't (or NO_RUN)
+static byte findVictim(byte n)
+{
+    static byte i, best, lru;
+    glyphRun *run;
+
+    best = NO_RUN;
+    lru = NO_RUN;
+    for (i = 0; i < RUNCACHE_SIZE; ++i)
+    {
+        run = &runCache[i];
+        if (run->adr && run->generation != gGraphGeneration)
+        {
+            run->adr = 0; // freed by fc_freeGraphAreas
+        }
+        if (run->adr && runShown(i))
+        {
+            continue;
+        }
+        if (run->adr && run->capacity >= n &&
+            (best == NO_RUN || run->capacity < runCache[best].capacity))
+        {
+            best = i;
+        }
+        if (lru == NO_RUN || !run->text ||
+            (runCache[lru].text &&
+             (word)(runClock - run->lastUse) > (word)(runClock - runCache[lru].lastUse)))
+        {
+            lru = i;
+        }
+    }
+    return best != NO_RUN ? best : lru;
+}
+
+// give run characters for n cells, keeping its old ones as a spare
+static bool provideChars(glyphRun *run, byte n)
+{
+    static byte i, best, empty;
+    spareChars *sp;
+    himemPtr adr;
+    byte capacity;
+
+    best = NO_RUN;
+    empty = NO_RUN;
+    for (i = 0; i < RUNCACHE_SIZE; ++i)
+    {
+        sp = &spares[i];
+        if (!sp->adr || sp->generation != gGraphGeneration)
+        {
+            sp->adr = 0;
+            empty = i;
+        }
+        else if (sp->capacity >= n && (best == NO_RUN || sp->capacity < spares[best].capacity))
+        {
+            best = i;
+        }
+    }
+
+    if (best != NO_RUN)
+    {
+        // swap with the spare
+        sp = &spares[best];
+        adr = sp->adr;
+        capacity = sp->capacity;
+        sp->adr = run->adr;
+        sp->capacity = run->capacity;
+        sp->generation = gGraphGeneration;
+        run->adr = adr;
+        run->capacity = capacity;
+        return true;
+    }
+    if (run->adr && empty == NO_RUN)
+    {
+        return false; // no room to keep the old characters
+    }
+    adr = fc_allocGraphMem(n * 64);
+    if (adr == 0)
+    {
+        return false;
+    }
+    if (run->adr)
+    {
+        sp = &spares[empty];
+        sp->adr = run->adr;
+        sp->capacity = run->capacity;
+        sp->generation = gGraphGeneration;
+    }
+    run->adr = adr;
+    run->capacity = n;
+    return true;
+}
+
+himemPtr fc_renderText(fcFont *f, const char *s, byte *cells)
+{
+    static byte i, n, count, victim;
+    glyphRun *run;
+    word width;
+
+    runClock++;
+
+    for (i = 0; i < RUNCACHE_SIZE; ++i)
+    {
+        run = &runCache[i];
+        if (run->text && run->font == f && run->generation == gGraphGeneration &&
+            run->bg == f->bg && run->fg == f->fg && !strcmp(run->text, s))
+        {
+            run->lastUse = runClock;
+            lastRun = i;
+            *cells = run->cells;
+            return run->adr;
+        }
+    }
+
+    width = fc_textWidth(f, s);
+    n = (width + 7) / 8;
+    if (n == 0)
+    {
+        n = 1;
+    }
+
+    // miss: take characters that aren't on screen any more
+    *cells = 0;
+    victim = findVictim(n);
+    if (victim == NO_RUN)
+    {
+        return 0;
+    }
+    run = &runCache[victim];
+    if (run->text)
+    {
+        free(run->text);
+        run->text = NULL;
+    }
+    if ((!run->adr || run->capacity < n) && !provideChars(run, n))
+    {
+        return 0;
+    }
+    run->text = strdup(s);
+    run->cells = n;
+    run->font = f;
+    run->bg = f->bg;
+    run->fg = f->fg;
+    run->generation = gGraphGeneration;
+    run->lastUse = runClock;
+    lastRun = victim;
+
+    for (i = 0; i < n; i += RENDER_CELLS)
+    {
+        count = n - i > RENDER_CELLS ? RENDER_CELLS : n - i;
+        renderCells(f, s, i, count);
+        lcopy((long)fcbuf, run->adr + (i * 64), count * 64);
+    }
+
+    *cells = n;
+    return run->adr;
+}
+
+byte fc_putText(fcFont *f, byte x, byte y, const char *s)
+{
+    himemPtr adr;
+    byte cells;
+
+    adr = fc_renderText(f, s, &cells);
+    if (adr == 0 ||
+        !addPlacement(lastRun, gScreenBase + cellOffset(gCurrentWin->x0 + x, gCurrentWin->y0 + y), cells))
+    {
+        return 0;
+    }
+    fc_addGraphicsRect(gCurrentWin->x0 + x, gCurrentWin->y0 + y, cells, 1, adr);
+    return cells;
+}
@@ -0,0 +1,421 @@
+/*
+ * fcgfx.c
+ * pixel drawing on full colour mode graphic areas
+ *
+ * Copyright (C) 2019-21 - Stephan Kleinert
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+surface layout (as assigned by fc_addGraphicsRect):
+
+characters are numbered row by row, each one holding 8x8 pixels as
+64 consecutive bytes (8 bytes per pixel row). so pixel (x,y) lives at
+
+  base + ((y/8) * columns + x/8) * 64 + (y%8) * 8 + x%8
+
+a pixel column inside one character is a DMA fill with a skip of 8,
+several pixel rows over the full width of a character are contiguous,
+and so are full characters next to each other.
+*/
+
+#include "fcio.h"
+#include "memory.h"
+#include <stdlib.h>
+
+static himemPtr pixelAdr(fciInfo *s, word x, word y)
+{
+    return s->baseAdr + (((long)((y >> 3) * s->columns + (x >> 3))) * 64) +
+           ((y & 7) * 8) + (x & 7);
+}
+
+// clip span/rectangle to surface; false if nothing is left
+static bool clip(fciInfo *s, word *x, word *y, word *w, word *h)
+{
+    word sw, sh;
+    sw = s->columns * 8;
+    sh = s->rows * 8;
+    if (*x >= sw || *y >= sh || *w == 0 || *h == 0)
+    {
+        return false;
+    }
+    if (*w > sw - *x)
+    {
+        *w = sw - *x;
+    }
+    if (*h > sh - *y)
+    {
+        *h = sh - *y;
+    }
+    return true;
+}
+
+void fc_plot(fciInfo *s, word x, word y, byte c)
+{
+    if (x < s->columns * 8 && y < s->rows * 8)
+    {
+        lpoke(pixelAdr(s, x, y), c);
+    }
+}
+
+byte fc_pixel(fciInfo *s, word x, word y)
+{
+    if (x < s->columns * 8 && y < s->rows * 8)
+    {
+        return lpeek(pixelAdr(s, x, y));
+    }
+    return 0;
+}
+
+void fc_hspan(fciInfo *s, word x, word y, word len, byte c)
+{
+    fc_fillRect(s, x, y, len, 1, c);
+}
+
+void fc_vspan(fciInfo *s, word x, word y, word len, byte c)
+{
+    static byte n;
+    word w = 1;
+
+    if (!clip(s, &x, &y, &w, &len))
+    {
+        return;
+    }
+    while (len)
+    {
+        // pixels left in this character cell
+        n = 8 - (y & 7);
+        if (n > len)
+        {
+            n = len;
+        }
+        lfill_skip(pixelAdr(s, x, y), c, n, 8);
+        len -= n;
+        y += n;
+    }
+}
+
+// fill part of one character cell, using whichever takes fewer DMA jobs
+static void fillCell(himemPtr adr, byte width, byte height, byte c)
+{
+    static byte i;
+    if (width < height)
+    {
+        for (i = 0; i < width; ++i)
+        {
+            lfill_skip(adr + i, c, height, 8);
+        }
+    }
+    else
+    {
+        for (i = 0; i < height; ++i)
+        {
+            lfill(adr + (i * 8), c, width);
+        }
+    }
+}
+
+void fc_fillRect(fciInfo *s, word x, word y, word w, word h, byte c)
+{
+    static byte n;
+    word xa, xb, cx;
+    himemPtr adr;
+
+    if (!clip(s, &x, &y, &w, &h))
+    {
+        return;
+    }
+
+    xa = (x + 7) & ~7;   // first full cell
+    xb = (x + w) & ~7;   // end of full cells
+
+    while (h)
+    {
+        n = 8 - (y & 7);
+        if (n > h)
+        {
+            n = h;
+        }
+
+        if (xa > xb)
+        {
+            // span lies inside a single cell
+            fillCell(pixelAdr(s, x, y), w, n, c);
+        }
+        else
+        {
+            if (x < xa)
+            {
+                fillCell(pixelAdr(s, x, y), xa - x, n, c);
+            }
+            if (xa < xb)
+            {
+                adr = pixelAdr(s, xa, y);
+                if (n == 8)
+                {
+                    // whole characters are contiguous
+                    lfill(adr, c, (xb - xa) * 8);
+                }
+                else
+                {
+                    for (cx = xa; cx < xb; cx += 8)
+                    {
+                        lfill(adr, c, n * 8);
+                        adr += 64;
+                    }
+                }
+            }
+            if (xb < x + w)
+            {
+                fillCell(pixelAdr(s, xb, y), (x + w) - xb, n, c);
+            }
+        }
+        h -= n;
+        y += n;
+    }
+}
+
+void fc_drawLine(fciInfo *s, word x0, word y0, word x1, word y1, byte c)
+{
+    int dx, dy, err, e2;
+    signed char sx, sy;
+
+    if (y0 == y1)
+    {
+        fc_hspan(s, x0 < x1 ? x0 : x1, y0, abs((int)x1 - (int)x0) + 1, c);
+        return;
+    }
+    if (x0 == x1)
+    {
+        fc_vspan(s, x0, y0 < y1 ? y0 : y1, abs((int)y1 - (int)y0) + 1, c);
+        return;
+    }
+
+    dx = abs((int)x1 - (int)x0);
+    dy = -abs((int)y1 - (int)y0);
+    sx = x0 < x1 ? 1 : -1;
+    sy = y0 < y1 ? 1 : -1;
+    err = dx + dy;
+
+    while (1)
+    {
+        fc_plot(s, x0, y0, c);
+        if (x0 == x1 && y0 == y1)
+        {
+            break;
+        }
+        e2 = 2 * err;
+        if (e2 >= dy)
+        {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx)
+        {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+void fc_drawRect(fciInfo *s, word x, word y, word w, word h, byte c)
+{
+    if (w == 0 || h == 0)
+    {
+        return;
+    }
+    fc_hspan(s, x, y, w, c);
+    fc_hspan(s, x, y + h - 1, w, c);
+    fc_vspan(s, x, y, h, c);
+    fc_vspan(s, x + w - 1, y, h, c);
+}
+
+// copy one pixel row segment between surfaces, bouncing through fcbuf
+static void copyRow(fciInfo *src, word sx, word sy,
+                    fciInfo *dst, word dx, word dy, word w)
+{
+    static byte n;
+    word i;
+
+    for (i = 0; i < w; i += n)
+    {
+        n = 8 - ((sx + i) & 7);
+        if (n > w - i)
+        {
+            n = w - i;
+        }
+        lcopy(pixelAdr(src, sx + i, sy), (long)fcbuf + i, n);
+    }
+    for (i = 0; i < w; i += n)
+    {
+        n = 8 - ((dx + i) & 7);
+        if (n > w - i)
+        {
+            n = w - i;
+        }
+        lcopy((long)fcbuf + i, pixelAdr(dst, dx + i, dy), n);
+    }
+}
+
+void fc_copyRect(fciInfo *src, word sx, word sy, word w, word h,
+                 fciInfo *dst, word dx, word dy)
+{
+    word row, chunk, i, c, lastChunk;
+    bool upwards, rightwards;
+
+    if (!clip(src, &sx, &sy, &w, &h) || !clip(dst, &dx, &dy, &w, &h))
+    {
+        return;
+    }
+
+    // overlapping copies on the same surface must not overwrite rows still to be read
+    upwards = (src == dst) && (dy > sy);
+
+    if (((sx | dx | w | sy | dy | h) & 7) == 0 && (src != dst || sy != dy))
+    {
+        // character aligned: copy whole character rows
+        for (row = 0; row < h; row += 8)
+        {
+            i = upwards ? h - 8 - row : row;
+            lcopy(pixelAdr(src, sx, sy + i), pixelAdr(dst, dx, dy + i), w * 8);
+        }
+        return;
+    }
+
+    // copyRow stages the row in fcbuf, so wide rows go in chunks. a move
+    // to the right inside the same rows must not overwrite pixels still
+    // to be read either, so then the chunks go from right to left
+    rightwards = (src == dst) && (dy == sy) && (dx > sx);
+    lastChunk = ((w - 1) / FCBUFSIZE) * FCBUFSIZE;
+    for (row = 0; row < h; ++row)
+    {
+        i = upwards ? h - 1 - row : row;
+        for (chunk = 0; chunk < w; chunk += FCBUFSIZE)
+        {
+            c = rightwards ? lastChunk - chunk : chunk;
+            copyRow(src, sx + c, sy + i, dst, dx + c, dy + i,
+                    (w - c) > FCBUFSIZE ? FCBUFSIZE : (w - c));
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// transparent blits and soft sprites
+// ----------------------------------------------------------------------------
+
+void fc_blitTransparent(fciInfo *src, fciInfo *dst, word x, word y, byte transparent)
+{
+    static byte n, yo, cx, cy;
+    word w, h, row, i;
+    himemPtr srcAdr;
+
+    w = src->columns * 8;
+    h = src->rows * 8;
+    if (!clip(dst, &x, &y, &w, &h))
+    {
+        return;
+    }
+
+    if ((x & 7) == 0 && w == src->columns * 8 && h == src->rows * 8)
+    {
+        yo = y & 7;
+        n = 8 - yo;
+        for (cy = 0; cy < src->rows; ++cy)
+        {
+            if (yo == 0)
+            {
+                // character aligned: a whole character row in one job
+                lcopy_trans(src->baseAdr + (long)cy * src->columns * 64,
+                            pixelAdr(dst, x, y + cy * 8), src->columns * 64, transparent);
+                continue;
+            }
+            // column aligned: each source character lands in two
+            // destination characters, pixel rows stay contiguous
+            for (cx = 0; cx < src->columns; ++cx)
+            {
+                srcAdr = src->baseAdr + ((long)cy * src->columns + cx) * 64;
+                lcopy_trans(srcAdr, pixelAdr(dst, x + cx * 8, y + cy * 8), n * 8, transparent);
+                lcopy_trans(srcAdr + n * 8, pixelAdr(dst, x + cx * 8, y + cy * 8 + n),
+                            yo * 8, transparent);
+            }
+        }
+        return;
+    }
+
+    // unaligned: row by row, one job per piece between character edges
+    for (row = 0; row < h; ++row)
+    {
+        for (i = 0; i < w; i += n)
+        {
+            n = 8 - ((x + i) & 7);
+            if (n > 8 - (i & 7))
+            {
+                n = 8 - (i & 7);
+            }
+            if (n > w - i)
+            {
+                n = w - i;
+            }
+            lcopy_trans(pixelAdr(src, i, row), pixelAdr(dst, x + i, y + row), n, transparent);
+        }
+    }
+}
+
+void fc_initSprite(softSprite *sp, fciInfo *image, fciInfo *surface, byte transparent)
+{
+    sp->image = image;
+    sp->surface = surface;
+    sp->background = fc_makeGraphArea(image->columns, image->rows);
+    sp->transparent = transparent;
+    sp->x = 0;
+    sp->y = 0;
+    sp->drawn = false;
+}
+
+void fc_hideSprites(softSprite *sprites, byte count)
+{
+    softSprite *sp;
+
+    // restore in reverse drawing order, so overlapping sprites
+    // leave the original background behind
+    while (count--)
+    {
+        sp = &sprites[count];
+        if (sp->drawn)
+        {
+            fc_copyRect(sp->background, 0, 0, sp->image->columns * 8, sp->image->rows * 8,
+                        sp->surface, sp->drawnX, sp->drawnY);
+            sp->drawn = false;
+        }
+    }
+}
+
+void fc_updateSprites(softSprite *sprites, byte count)
+{
+    static byte i;
+    softSprite *sp;
+
+    fc_hideSprites(sprites, count);
+    for (i = 0; i < count; ++i)
+    {
+        sp = &sprites[i];
+        fc_copyRect(sp->surface, sp->x, sp->y, sp->image->columns * 8, sp->image->rows * 8,
+                    sp->background, 0, 0);
+        fc_blitTransparent(sp->image, sp->surface, sp->x, sp->y, sp->transparent);
+        sp->drawnX = sp->x;
+        sp->drawnY = sp->y;
+        sp->drawn = true;
+    }
+}
@@ -23,6 +23,7 @@
 #include <c64.h>
 #include <cbm.h>
 #include <conio.h> // important: need the CC65 conio here; m65 replacement WON'T WORK.
+#include <6502.h>
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -31,9 +32,15 @@
 #include <time.h>
 #include <stdbool.h>
 #include "utils.h"
+#include "vic4.h"
+#include "raster.h"
+#include "pointer.h"
+#include "scrollback.h"
+#include "split.h"
+#include "hwmath.h"
 
 #define MAX_FCI_BLOCKS 16
-#define MAX_WINDOWS 8
+#define MAX_SAVEUNDER 8
 
 #define TOPBORDER_PAL 0x58
 #define BOTTOMBORDER_PAL 0x1e8
@@ -47,50 +54,60 @@ fciInfo **infoBlocks = (fciInfo **)0x0600; // pointers to fci info blocks
 textwin *defaultWin = (textwin *)0x0700;
 
 textwin *gCurrentWin;
-byte winCount = MAX_WINDOWS;
 
-#define VIC_BASE 0xD000UL
-
-#define VIC2CTRL (*(unsigned char *)(0xd016))
-#define VIC4CTRL (*(unsigned char *)(0xd054))
-#define VIC3CTRL (*(unsigned char *)(0xd031))
-#define LINESTEP_LO (*(unsigned char *)(0xd058))
-#define LINESTEP_HI (*(unsigned char *)(0xd059))
-#define CHRCOUNT (*(unsigned char *)(0xd05e))
-#define HOTREG (*(unsigned char *)(0xd05d))
+typedef struct _saveUnder
+{
+    textwin win;       // the popup window
+    textwin *prevWin;  // window to reactivate when popping
+    himemPtr saveAdr;  // saved screen cells, followed by colour cells
+} saveUnder;
 
-#define SCNPTR_0 (*(unsigned char *)(0xd060))
-#define SCNPTR_1 (*(unsigned char *)(0xd061))
-#define SCNPTR_2 (*(unsigned char *)(0xd062))
-#define SCNPTR_3 (*(unsigned char *)(0xd063))
+saveUnder saveStack[MAX_SAVEUNDER];
+byte saveCount;
+himemPtr nextFreeSaveMem = SAVEUNDERBASE;
 
-#define COLOUR_RAM_OFFSET COLBASE - 0xff80000l
+#define ASCIIKEY (*(unsigned char *)(0xd610))
+#define MODKEY (*(unsigned char *)(0xd611))
 
 // special graphics characters
 #define H_COLUMN_END 4
 #define H_COLUMN_START 5
-#define CURSOR_CHARACTER 0x5f
 
 #define bitset(byte, nbit) ((byte) |= (1 << (nbit)))
 #define bitclear(byte, nbit) ((byte) &= ~(1 << (nbit)))
 #define bitflip(byte, nbit) ((byte) ^= (1 << (nbit)))
 #define bitcheck(byte, nbit) ((byte) & (1 << (nbit)))
 
+himemPtr gScreenBase;      // screen memory fcio output goes to
+himemPtr gColourBase;      // colour memory fcio output goes to
 word gScreenSize;          // screen size (in characters)
+word gScreenRowBytes;      // bytes per row of screen and colour memory
 byte gScreenColumns;       // number of screen columns (in characters)
 byte gScreenRows;          // number of screen rows (in characters)
 himemPtr nextFreeGraphMem; // location of next free graphics block in banks 4 & 5
 himemPtr nextFreePalMem;   // location of next free palette memory block
 byte infoBlockCount;       // number of info blocks
+byte gGraphGeneration;     // bumped whenever graphic areas are freed
 byte cgi;                  // universal loop var
 
 int gTopBorder;
 int gBottomBorder;
 
 // flags
-bool csrflag; // cursor on/off
 bool autoCR;
 
+// keyboard ring buffer, filled by the irq handler
+#define KEYBUFSIZE 32 // must be power of 2
+#define IRQSTACKSIZE 256
+
+byte keyBuf[KEYBUFSIZE];
+byte keyModBuf[KEYBUFSIZE];
+byte keyHead;     // next free slot (only written by irq)
+byte keyTail;     // next key to read (only written by main program)
+byte lastKeyMods; // modifiers of last key read
+byte irqStack[IRQSTACKSIZE];
+bool irqInstalled;
+
 #define DEBUG
 
 void fc_loadReservedBitmap(char *name)
@@ -99,6 +116,165 @@ void fc_loadReservedBitmap(char *name)
     fc_resetPalette();
 }
 
+void fc_pollKeyboard(void)
+{
+    static byte next;
+    while (ASCIIKEY)
+    {
+        next = (keyHead + 1) & (KEYBUFSIZE - 1);
+        if (next == keyTail)
+        {
+            return; // buffer full; leave the rest in the hardware queue
+        }
+        keyBuf[keyHead] = ASCIIKEY;
+        keyModBuf[keyHead] = MODKEY;
+        keyHead = next;
+        ASCIIKEY = 0; // any write removes the key from the hardware queue
+    }
+}
+
+// smooth scrolling state, advanced once per frame by a vertical blank handler.
+// the main program only touches scrollPixels and scrollActive with
+// interrupts off, an int takes two accesses.
+volatile int scrollPixels;   // pixels left to scroll (> 0: content moves up)
+byte scrollSpeed;            // pixels per frame
+byte scrollFine;             // content is currently shifted up by this many pixels
+int scrollTextY;             // text y position without fine offset
+byte scrollUnit;             // raster lines per pixel
+volatile bool scrollActive;  // extra row displayed, irq busy
+void (*scrollFeeder)(byte row);
+
+static void clearScreenRow(byte row)
+{
+    long bas;
+    bas = cellOffset(0, row);
+    lfill_skip(gScreenBase + bas, 32, gScreenColumns, 2);
+    lfill_skip(gScreenBase + bas + 1, 0, gScreenColumns, 2);
+    lfill(gColourBase + bas, 0, gScreenColumns * 2);
+}
+
+// move the whole screen including the row below it up by one row
+static void coarseScrollUp(void)
+{
+    word rowBytes;
+    rowBytes = gScreenRowBytes;
+    lcopy(gScreenBase + rowBytes, gScreenBase, gScreenRows * rowBytes);
+    lcopy(gColourBase + rowBytes, gColourBase, gScreenRows * rowBytes);
+    clearScreenRow(gScreenRows);
+    if (scrollFeeder)
+    {
+        scrollFeeder(gScreenRows);
+    }
+}
+
+static void coarseScrollDown(void)
+{
+    static signed char y;
+    word rowBytes;
+    rowBytes = gScreenRowBytes;
+    for (y = gScreenRows - 1; y >= 0; --y)
+    {
+        lcopy(gScreenBase + (y * rowBytes), gScreenBase + ((y + 1) * rowBytes), rowBytes);
+        lcopy(gColourBase + (y * rowBytes), gColourBase + ((y + 1) * rowBytes), rowBytes);
+    }
+    clearScreenRow(0);
+    if (scrollFeeder)
+    {
+        scrollFeeder(0);
+    }
+}
+
+static void smoothScrollFrame(void)
+{
+    static byte step;
+    static int y;
+
+    if (!scrollActive)
+    {
+        return;
+    }
+
+    if (scrollPixels > 0)
+    {
+        step = scrollPixels > scrollSpeed ? scrollSpeed : scrollPixels;
+        scrollPixels -= step;
+        scrollFine += step;
+        if (scrollFine >= 8)
+        {
+            coarseScrollUp();
+            scrollFine -= 8;
+        }
+    }
+    else if (scrollPixels < 0)
+    {
+        step = -scrollPixels > scrollSpeed ? scrollSpeed : -scrollPixels;
+        scrollPixels += step;
+        if (scrollFine < step)
+        {
+            coarseScrollDown();
+            scrollFine += 8;
+        }
+        scrollFine -= step;
+    }
+
+    y = scrollTextY - (scrollFine * scrollUnit);
+    TEXTYPOS_LO = y & 0xff;
+    TEXTYPOS_HI = (TEXTYPOS_HI & 0xf0) | ((y >> 8) & 0x0f);
+
+    if (scrollPixels == 0 && scrollFine == 0)
+    {
+        DISPROWS = gScreenRows;
+        scrollActive = false;
+    }
+}
+
+byte fc_irq(void)
+{
+    fc_pollKeyboard();
+    if (VICIRQ & 0x01)
+    {
+        VICIRQ = 0x01; // acknowledge raster irq
+        rasterIrq();
+        return IRQ_HANDLED;
+    }
+    return IRQ_NOT_HANDLED;
+}
+
+void fc_smoothScroll(int dy, byte speed)
+{
+    if (speed == 0 || speed > 8)
+    {
+        speed = 8;
+    }
+    SEI();
+    if (!scrollActive)
+    {
+        scrollTextY = TEXTYPOS_LO | ((TEXTYPOS_HI & 0x0f) << 8);
+        scrollUnit = (VIC3CTRL & 0x08) ? 1 : 2;
+        scrollFine = 0;
+        clearScreenRow(gScreenRows);
+        DISPROWS = gScreenRows + 1;
+        scrollActive = true;
+    }
+    scrollPixels += dy;
+    scrollSpeed = speed;
+    CLI();
+}
+
+bool fc_smoothScrolling(void)
+{
+    static bool busy;
+    SEI();
+    busy = scrollPixels != 0;
+    CLI();
+    return busy;
+}
+
+void fc_setScrollFeeder(void (*feeder)(byte row))
+{
+    scrollFeeder = feeder;
+}
+
 void fc_init(byte h640, byte v400, byte rows, char *reservedBitmapFile)
 {
     mega65_io_enable();
@@ -114,6 +290,18 @@ void fc_init(byte h640, byte v400, byte rows, char *reservedBitmapFile)
         gBottomBorder = BOTTOMBORDER_NTSC;
     }
 
+    if (!irqInstalled)
+    {
+        keyHead = 0;
+        keyTail = 0;
+        set_irq(&fc_irq, irqStack, IRQSTACKSIZE);
+        irqInstalled = true;
+
+        // vertical blank: just below the bottom border
+        rasterInit((gBottomBorder / 2) + 2);
+        fc_addRasterHandler((gBottomBorder / 2) + 2, smoothScrollFrame);
+    }
+
     puts("\n");       // cancel leftover quote mode from wrapper or whatever
     cbm_k_bsout(14);  // lowercase
     cbm_k_bsout(147); // clr
@@ -190,21 +378,167 @@ void fc_resetPalette()
     fc_loadPalette(SYSPAL, 255, false);
 }
 
+/*
+compact printf replacement which hands every character to the
+output function as soon as it's formatted. supports %c, %s, %d, %i,
+%u, %x, %X and %% with optional '-' (left align), '0' (zero padding)
+and field width.
+*/
+
+static char numbuf[7];
+
+static char *formatNumber(unsigned int val, byte radix, const char *digitChars)
+{
+    static char *p;
+    p = numbuf + sizeof(numbuf) - 1;
+    *p = 0;
+    if (radix == 16)
+    {
+        do
+        {
+            *--p = digitChars[val & 15];
+            val >>= 4;
+        } while (val);
+    }
+    else
+    {
+        do
+        {
+            *--p = digitChars[val % 10];
+            val /= 10;
+        } while (val);
+    }
+    return p;
+}
+
+void fc_vformat(void (*out)(char), const char *format, va_list args)
+{
+    static char c;
+    static const char *str;
+    static byte width, len;
+    static char pad, sign;
+    static bool left;
+    static int val;
+
+    while ((c = *format++))
+    {
+        if (c != '%')
+        {
+            out(c);
+            continue;
+        }
+
+        left = false;
+        pad = ' ';
+        sign = 0;
+        width = 0;
+
+        c = *format++;
+        if (c == '-')
+        {
+            left = true;
+            c = *format++;
+        }
+        if (c == '0')
+        {
+            pad = '0';
+            c = *format++;
+        }
+        while (c >= '0' && c <= '9')
+        {
+            width = (width * 10) + (c - '0');
+            c = *format++;
+        }
+
+        switch (c)
+        {
+        case 0:
+            return;
+        case 'c':
+            numbuf[0] = va_arg(args, int);
+            numbuf[1] = 0;
+            str = numbuf;
+            pad = ' ';
+            break;
+        case 's':
+            str = va_arg(args, const char *);
+            pad = ' ';
+            break;
+        case 'd':
+        case 'i':
+            val = va_arg(args, int);
+            if (val < 0)
+            {
+                sign = '-';
+                val = -val;
+            }
+            str = formatNumber(val, 10, "0123456789");
+            break;
+        case 'u':
+            str = formatNumber(va_arg(args, unsigned int), 10, "0123456789");
+            break;
+        case 'x':
+            str = formatNumber(va_arg(args, unsigned int), 16, "0123456789abcdef");
+            break;
+        case 'X':
+            str = formatNumber(va_arg(args, unsigned int), 16, "0123456789ABCDEF");
+            break;
+        default:
+            out(c); // '%%' and unsupported conversions
+            continue;
+        }
+
+        len = strlen(str);
+        if (sign)
+        {
+            ++len;
+            if (pad == '0')
+            {
+                out(sign); // sign goes in front of zero padding
+                sign = 0;
+            }
+        }
+        if (!left)
+        {
+            for (; len < width; ++len)
+            {
+                out(pad);
+            }
+        }
+        if (sign)
+        {
+            out(sign);
+        }
+        while (*str)
+        {
+            out(*str++);
+        }
+        for (; len < width; ++len)
+        {
+            out(' ');
+        }
+    }
+}
+
+static void fatalOut(char c)
+{
+    cbm_k_bsout(c);
+}
+
 void fc_fatal(const char *format, ...)
 {
-    char buf[160];
     va_list args;
 
     mega65_io_enable();
-    va_start(args, format);
-    vsprintf(buf, format, args);
-    va_end(args);
     fc_go8bit();
     bordercolor(2);
     textcolor(2);
     bgcolor(0);
     puts("## fatal error ##");
-    puts(buf);
+    va_start(args, format);
+    fc_vformat(fatalOut, format, args);
+    va_end(args);
+    cbm_k_bsout('\n');
     while (1)
         ;
 }
@@ -222,11 +556,12 @@ void fc_freeGraphAreas(void)
     nextFreeGraphMem = GRAPHBASE;
     nextFreePalMem = PALBASE;
     infoBlockCount = 0;
+    gGraphGeneration++;
 }
 
 /*
 very simple graphics memory allocation scheme:
-try to find space in 128K beginning at GRAPHBASE, without
+try to find space between GRAPHBASE and ATLASBASE, without
 crossing bank boundaries. If everything's full, bail out.
 */
 
@@ -244,7 +579,7 @@ himemPtr fc_allocGraphMem(word size)
         nextFreeGraphMem = GRAPHBASE + 0x10000;
         adr = nextFreeGraphMem;
     }
-    if (nextFreeGraphMem + size < GRAPHBASE + 0x20000)
+    if (nextFreeGraphMem + size < ATLASBASE) // the atlas takes the top of bank 5
     {
         nextFreeGraphMem += size;
         return adr;
@@ -252,6 +587,45 @@ himemPtr fc_allocGraphMem(word size)
     return 0;
 }
 
+// info block for a new graphic area, freed by fc_freeGraphAreas
+static fciInfo *newInfoBlock(void)
+{
+    fciInfo *info;
+
+    if (infoBlockCount == MAX_FCI_BLOCKS)
+    {
+        fc_fatal("too many graph areas");
+    }
+    info = (fciInfo *)malloc(sizeof(fciInfo));
+    infoBlocks[infoBlockCount++] = info;
+    return info;
+}
+
+fciInfo *fc_makeGraphArea(byte columns, byte rows)
+{
+    fciInfo *info;
+    word size;
+
+    size = columns * rows * 64;
+    info = newInfoBlock();
+
+    info->baseAdr = fc_allocGraphMem(size);
+    if (info->baseAdr == 0)
+    {
+        fc_fatal("no memory for graph area");
+    }
+    lfill(info->baseAdr, 0, size);
+
+    info->columns = columns;
+    info->rows = rows;
+    info->size = size;
+    info->paletteAdr = 0;
+    info->paletteSize = 0;
+    info->reservedSysPalette = false;
+    info->ncm = false;
+    return info;
+}
+
 himemPtr fc_allocPalMem(word size)
 {
     himemPtr adr = nextFreePalMem;
@@ -311,6 +685,7 @@ void fc_screenmode(byte h640, byte v400, byte rows)
 {
     int extraRows = 0;
 
+    splitStop();
     mega65_io_enable();
     if (rows == 0)
     {
@@ -349,8 +724,11 @@ void fc_screenmode(byte h640, byte v400, byte rows)
     }
 
     gScreenSize = gScreenRows * gScreenColumns;
-    lfill_skip(SCREENBASE, 32, gScreenSize, 2);
-    lfill(COLBASE, 0, gScreenSize * 2);
+    gScreenRowBytes = gScreenColumns * 2;
+    gScreenBase = SCREENBASE;
+    gColourBase = COLBASE;
+    lfill_skip(gScreenBase, 32, gScreenSize, 2);
+    lfill(gColourBase, 0, gScreenSize * 2);
 
     HOTREG &= 127; // disable hotreg
 
@@ -360,8 +738,8 @@ void fc_screenmode(byte h640, byte v400, byte rows)
     }
 
     // move colour RAM because of stupid CBDOS himem usage
-    POKE(53348u, COLOUR_RAM_OFFSET & 0xff);
-    POKE(53349u, (COLOUR_RAM_OFFSET >> 8) & 0xff);
+    COLPTR_LO = COLOUR_RAM_OFFSET & 0xff;
+    COLPTR_HI = (COLOUR_RAM_OFFSET >> 8) & 0xff;
 
     CHRCOUNT = gScreenColumns;
     LINESTEP_LO = gScreenColumns * 2; // *2 to have 2 screen bytes == 1 character
@@ -400,12 +778,15 @@ void fc_go8bit()
 
 void fc_plotExtChar(byte x, byte y, byte c)
 {
-    word charIdx;
+    fc_plotCharIdx(x, y, (EXTCHARBASE / 64) + c);
+}
+
+void fc_plotCharIdx(byte x, byte y, word charIdx)
+{
     long adr;
-    charIdx = (EXTCHARBASE / 64) + c;
-    adr = (x * 2) + (y * gScreenColumns * 2);
-    lpoke(SCREENBASE + adr, charIdx % 256);
-    lpoke(SCREENBASE + adr + 1, charIdx / 256);
+    adr = cellOffset(x, y);
+    lpoke(gScreenBase + adr, charIdx % 256);
+    lpoke(gScreenBase + adr + 1, charIdx / 256);
 }
 
 void fc_addGraphicsRect(byte x0, byte y0, byte width, byte height,
@@ -419,22 +800,173 @@ void fc_addGraphicsRect(byte x0, byte y0, byte width, byte height,
 
     for (y = y0; y < y0 + height; ++y)
     {
+        // clear ncm/gotox attributes possibly left over from a previous image
+        lfill_skip(gColourBase + cellOffset(x0, y), 0, width, 2);
+        adr = gScreenBase + cellOffset(x0, y);
         for (x = x0; x < x0 + width; ++x)
         {
-            adr = SCREENBASE + (x * 2) + (y * gScreenColumns * 2);
             lpoke(adr + 1, currentCharIdx / 256); // set highbyte first to avoid blinking
             lpoke(adr, currentCharIdx % 256);     // while setting up the screeen
+            adr += 2;
             currentCharIdx++;
         }
     }
 }
 
+void fc_addNCMGraphicsRect(byte x0, byte y0, byte width, byte height,
+                           himemPtr bitmapData, byte colourBank)
+{
+    static byte x, y;
+    word currentCharIdx;
+    word gotoX;
+    word rowOffset;
+    byte *scr;
+
+    currentCharIdx = bitmapData / 64;
+    gotoX = (x0 + (width * 2)) * 8; // first pixel right of the image
+
+    // the gotox half of each row never changes
+    scr = (byte *)fcbuf + (width * 2);
+    for (x = 0; x < width; ++x)
+    {
+        *scr++ = gotoX % 256;
+        *scr++ = gotoX / 256;
+    }
+
+    for (y = y0; y < y0 + height; ++y)
+    {
+        scr = (byte *)fcbuf;
+        for (x = 0; x < width; ++x)
+        {
+            *scr++ = currentCharIdx % 256;
+            *scr++ = currentCharIdx / 256;
+            currentCharIdx++;
+        }
+        rowOffset = cellOffset(x0, y);
+        lcopy((long)fcbuf, gScreenBase + rowOffset, width * 4);
+        lfill_skip(gColourBase + rowOffset, ATTR_NCM, width, 2);
+        lfill_skip(gColourBase + rowOffset + 1, colourBank * 16, width, 2);
+        lfill_skip(gColourBase + rowOffset + (width * 2), ATTR_GOTOX, width, 2);
+        lfill_skip(gColourBase + rowOffset + (width * 2) + 1, 0, width, 2);
+    }
+}
+
+static void addFCIRect(fciInfo *info, byte x0, byte y0)
+{
+    if (info->ncm)
+    {
+        // ncm palettes live in the bank after the system colours if reserved
+        fc_addNCMGraphicsRect(x0, y0, info->columns, info->rows, info->baseAdr,
+                              info->reservedSysPalette ? 1 : 0);
+    }
+    else
+    {
+        fc_addGraphicsRect(x0, y0, info->columns, info->rows, info->baseAdr);
+    }
+}
+
+void fc_displayFCIRect(fciInfo *info, byte srcX, byte srcY, byte width, byte height,
+                       byte dstX, byte dstY)
+{
+    static byte x, y, cellsPerChar;
+    word charIdx;
+    word gotoX;
+    word rowOffset;
+    byte *scr;
+
+    if (srcX >= info->columns || srcY >= info->rows ||
+        dstX >= gCurrentWin->width || dstY >= gCurrentWin->height)
+    {
+        return;
+    }
+
+    // clip to the image, then to the window. ncm characters take two columns
+    cellsPerChar = info->ncm ? 2 : 1;
+    if (width > info->columns - srcX)
+    {
+        width = info->columns - srcX;
+    }
+    if (width > (gCurrentWin->width - dstX) / cellsPerChar)
+    {
+        width = (gCurrentWin->width - dstX) / cellsPerChar;
+    }
+    if (height > info->rows - srcY)
+    {
+        height = info->rows - srcY;
+    }
+    if (height > gCurrentWin->height - dstY)
+    {
+        height = gCurrentWin->height - dstY;
+    }
+    if (width == 0)
+    {
+        return;
+    }
+
+    dstX += gCurrentWin->x0;
+    dstY += gCurrentWin->y0;
+    charIdx = (info->baseAdr / 64) + (word)mathMul(srcY, info->columns) + srcX;
+
+    if (info->ncm)
+    {
+        // the gotox half of each row never changes
+        gotoX = (dstX + (width * 2)) * 8;
+        scr = (byte *)fcbuf + (width * 2);
+        for (x = 0; x < width; ++x)
+        {
+            *scr++ = gotoX % 256;
+            *scr++ = gotoX / 256;
+        }
+    }
+
+    for (y = 0; y < height; ++y)
+    {
+        scr = (byte *)fcbuf;
+        for (x = 0; x < width; ++x)
+        {
+            *scr++ = (charIdx + x) % 256;
+            *scr++ = (charIdx + x) / 256;
+        }
+        charIdx += info->columns;
+
+        rowOffset = cellOffset(dstX, dstY + y);
+        lcopy((long)fcbuf, gScreenBase + rowOffset, width * 2 * cellsPerChar);
+        if (info->ncm)
+        {
+            lfill_skip(gColourBase + rowOffset, ATTR_NCM, width, 2);
+            lfill_skip(gColourBase + rowOffset + 1, info->reservedSysPalette ? 16 : 0, width, 2);
+            lfill_skip(gColourBase + rowOffset + (width * 2), ATTR_GOTOX, width, 2);
+            lfill_skip(gColourBase + rowOffset + (width * 2) + 1, 0, width, 2);
+        }
+        else
+        {
+            // clear ncm/gotox attributes possibly left over from a previous image
+            lfill_skip(gColourBase + rowOffset, 0, width, 2);
+        }
+    }
+}
+
+void fc_displayFCIFrame(fciInfo *info, byte frameWidth, byte frameHeight, word frame,
+                        byte dstX, byte dstY)
+{
+    static byte perRow;
+
+    perRow = info->columns / frameWidth;
+    if (perRow == 0)
+    {
+        return;
+    }
+    fc_displayFCIRect(info, (frame % perRow) * frameWidth, (frame / perRow) * frameHeight,
+                      frameWidth, frameHeight, dstX, dstY);
+}
+
 fciInfo *fc_loadFCI(char *filename, himemPtr address, himemPtr paletteAddress)
 {
 
     static byte numColumns, numRows, numColours;
     static byte fciOptions;
     static byte reservedSysPalette;
+    static byte ncm;
 
     FILE *fcifile;
     byte *palette;
@@ -449,8 +981,7 @@ fciInfo *fc_loadFCI(char *filename, himemPtr address, himemPtr paletteAddress)
 
     if (!address)
     {
-        info = (fciInfo *)malloc(sizeof(fciInfo));
-        infoBlocks[infoBlockCount++] = info;
+        info = newInfoBlock();
     }
 
     fcifile = fopen(filename, "rb");
@@ -466,6 +997,7 @@ fciInfo *fc_loadFCI(char *filename, himemPtr address, himemPtr paletteAddress)
     fciOptions = fcbuf[7];
     numColours = fcbuf[8];
     reservedSysPalette = fciOptions & 2;
+    ncm = fciOptions & 4;
 
     palsize = numColours * 3;
     palette = (byte *)malloc(palsize);
@@ -518,6 +1050,7 @@ fciInfo *fc_loadFCI(char *filename, himemPtr address, himemPtr paletteAddress)
         info->paletteAdr = palAdr;
         info->paletteSize = numColours;
         info->reservedSysPalette = reservedSysPalette;
+        info->ncm = ncm;
     }
 
     mega65_io_enable(); // kernal has the disgusting habit of resetting vic personality
@@ -560,6 +1093,7 @@ void fc_fadePalette(himemPtr adr, byte size, byte reservedSysPalette, byte steps
     byte startReg;
     byte *destPalette;
     byte *entry;
+    word factor;
 
     byte start, end, step;
 
@@ -582,12 +1116,14 @@ void fc_fadePalette(himemPtr adr, byte size, byte reservedSysPalette, byte steps
 
     for (i = start; i != end; i += step)
     {
+        // one division per step, then a multiplication per channel
+        factor = mathDiv((word)i << 8, steps);
         entry = destPalette + (startReg * 3);
         for (cgi = startReg; cgi < size; ++cgi, entry += 3)
         {
-            POKE(0xd100u + cgi, nyblswap((*(entry)*i) / steps));
-            POKE(0xd200u + cgi, nyblswap((*(entry + 1) * i) / steps));
-            POKE(0xd300u + cgi, nyblswap((*(entry + 2) * i) / steps));
+            POKE(0xd100u + cgi, nyblswap(mathScale(*entry, factor)));
+            POKE(0xd200u + cgi, nyblswap(mathScale(*(entry + 1), factor)));
+            POKE(0xd300u + cgi, nyblswap(mathScale(*(entry + 2), factor)));
         }
     }
     free(destPalette);
@@ -596,13 +1132,13 @@ void fc_fadePalette(himemPtr adr, byte size, byte reservedSysPalette, byte steps
 void fc_fadeFCI(fciInfo *info, byte x0, byte y0, byte steps)
 {
     fc_zeroPalette(info->reservedSysPalette);
-    fc_addGraphicsRect(x0, y0, info->columns, info->rows, info->baseAdr);
+    addFCIRect(info, x0, y0);
     fc_fadePalette(info->paletteAdr, info->paletteSize, info->reservedSysPalette, steps, false);
 }
 
 void fc_displayFCI(fciInfo *info, byte x0, byte y0, bool setPalette)
 {
-    fc_addGraphicsRect(x0, y0, info->columns, info->rows, info->baseAdr);
+    addFCIRect(info, x0, y0);
     if (setPalette)
     {
         fc_loadFCIPalette(info);
@@ -626,32 +1162,28 @@ fciInfo *fc_displayFCIFile(char *filename, byte x0, byte y0)
 void fc_scrollUp()
 {
     static byte y;
-    long bas0, bas1;
-    for (y = gCurrentWin->y0; y < gCurrentWin->y0 + gCurrentWin->height - 1; y++)
+    word bas;
+    scrollbackPush();
+    bas = cellOffset(gCurrentWin->x0, gCurrentWin->y0);
+    for (y = 1; y < gCurrentWin->height; y++)
     {
-        bas0 = SCREENBASE + (gCurrentWin->x0 * 2 + (y * gScreenColumns * 2));
-        bas1 = SCREENBASE + (gCurrentWin->x0 * 2 + ((y + 1) * gScreenColumns * 2));
-        lcopy(bas1, bas0, gCurrentWin->width * 2);
-        bas0 = COLBASE + (gCurrentWin->x0 * 2 + (y * gScreenColumns * 2));
-        bas1 = COLBASE + (gCurrentWin->x0 * 2 + ((y + 1) * gScreenColumns * 2));
-        lcopy(bas1, bas0, gCurrentWin->width * 2);
+        lcopy(gScreenBase + bas + gScreenRowBytes, gScreenBase + bas, gCurrentWin->width * 2);
+        lcopy(gColourBase + bas + gScreenRowBytes, gColourBase + bas, gCurrentWin->width * 2);
+        bas += gScreenRowBytes;
     }
     fc_line(0, gCurrentWin->height - 1, gCurrentWin->width, 32, gCurrentWin->textcolor);
 }
 
 void fc_scrollDown()
 {
-    signed char y;
-    long bas0, bas1;
-    for (y = gCurrentWin->y0 + gCurrentWin->height - 2;
-         y >= gCurrentWin->y0; y--)
+    static byte y;
+    word bas;
+    bas = cellOffset(gCurrentWin->x0, gCurrentWin->y0 + gCurrentWin->height - 2);
+    for (y = 1; y < gCurrentWin->height; y++)
     {
-        bas0 = SCREENBASE + (gCurrentWin->x0 * 2 + (y * gScreenColumns * 2));
-        bas1 = SCREENBASE + (gCurrentWin->x0 * 2 + ((y + 1) * gScreenColumns * 2));
-        lcopy(bas0, bas1, gCurrentWin->width * 2);
-        bas0 = COLBASE + (gCurrentWin->x0 * 2 + (y * gScreenColumns * 2));
-        bas1 = COLBASE + (gCurrentWin->x0 * 2 + ((y + 1) * gScreenColumns * 2));
-        lcopy(bas0, bas1, gCurrentWin->width * 2);
+        lcopy(gScreenBase + bas, gScreenBase + bas + gScreenRowBytes, gCurrentWin->width * 2);
+        lcopy(gColourBase + bas, gColourBase + bas + gScreenRowBytes, gCurrentWin->width * 2);
+        bas -= gScreenRowBytes;
     }
 
     fc_line(0, 0, gCurrentWin->width, 32, gCurrentWin->textcolor);
@@ -671,11 +1203,60 @@ void cr()
 void fc_plotPetsciiChar(byte x, byte y, byte c, byte color, byte exAttr)
 {
     word adrOffset;
-    adrOffset = (x * 2) + (y * 2 * gScreenColumns);
-    lpoke(SCREENBASE + adrOffset, c);
-    lpoke(SCREENBASE + adrOffset + 1, 0);
-    lpoke(COLBASE + adrOffset + 1, color | exAttr);
-    lpoke(COLBASE + adrOffset, 0);
+    adrOffset = cellOffset(x, y);
+    lpoke(gScreenBase + adrOffset, c);
+    lpoke(gScreenBase + adrOffset + 1, 0);
+    lpoke(gColourBase + adrOffset + 1, color | exAttr);
+    lpoke(gColourBase + adrOffset, 0);
+}
+
+void fc_putCells(byte x, byte y, byte count, himemPtr chars, himemPtr colours)
+{
+    word adrOffset;
+
+    if (x >= gCurrentWin->width || y >= gCurrentWin->height)
+    {
+        return;
+    }
+    if (count > gCurrentWin->width - x)
+    {
+        count = gCurrentWin->width - x;
+    }
+    if (count == 0)
+    {
+        return; // a DMA count of 0 would copy 64K
+    }
+
+    adrOffset = cellOffset(gCurrentWin->x0 + x, gCurrentWin->y0 + y);
+    lcopy(chars, gScreenBase + adrOffset, count * 2);
+    if (colours)
+    {
+        lcopy(colours, gColourBase + adrOffset, count * 2);
+    }
+}
+
+void fc_putCellRect(byte x, byte y, byte width, byte height,
+                    himemPtr chars, himemPtr colours, word stride)
+{
+    static byte row;
+
+    if (y >= gCurrentWin->height || x >= gCurrentWin->width || width == 0)
+    {
+        return;
+    }
+    if (height > gCurrentWin->height - y)
+    {
+        height = gCurrentWin->height - y;
+    }
+    for (row = 0; row < height; ++row)
+    {
+        fc_putCells(x, y + row, width, chars, colours);
+        chars += stride * 2;
+        if (colours)
+        {
+            colours += stride * 2;
+        }
+    }
 }
 
 byte fc_wherex() { return gCurrentWin->xc; }
@@ -719,12 +1300,6 @@ void fc_putc(char c)
             }
         }
     }
-
-    if (csrflag)
-    {
-        fc_plotPetsciiChar(gCurrentWin->xc + gCurrentWin->x0, gCurrentWin->yc + gCurrentWin->y0,
-                           CURSOR_CHARACTER, gCurrentWin->textcolor, 16);
-    }
 }
 
 void _debug_fc_puts(const char *s)
@@ -770,10 +1345,7 @@ void fc_putcxy(byte x, byte y, char c)
 
 void fc_cursor(byte onoff)
 {
-    csrflag = onoff;
-    fc_plotPetsciiChar(gCurrentWin->xc + gCurrentWin->x0, gCurrentWin->yc + gCurrentWin->y0,
-                       gCurrentWin->textcolor,
-                       (csrflag ? CURSOR_CHARACTER : 32), (csrflag ? 16 : 0));
+    pointerCursor(onoff);
 }
 
 void box16(byte x0, byte y0, byte x1, byte y1, byte b, byte c)
@@ -784,10 +1356,10 @@ void box16(byte x0, byte y0, byte x1, byte y1, byte b, byte c)
     {
         for (y = y0; y <= y1; ++y)
         {
-            adrOffset = x * 2 + (y * 2 * gScreenColumns);
-            lpoke(SCREENBASE + adrOffset, b);
-            lpoke(SCREENBASE + adrOffset + 1, 0);
-            lpoke(COLBASE + adrOffset + 1, c);
+            adrOffset = cellOffset(x, y);
+            lpoke(gScreenBase + adrOffset, b);
+            lpoke(gScreenBase + adrOffset + 1, 0);
+            lpoke(gColourBase + adrOffset + 1, c);
         }
     }
 }
@@ -802,12 +1374,10 @@ void fc_gotoxy(byte x, byte y)
 
 void fc_printf(const char *format, ...)
 {
-    char buf[160];
     va_list args;
     va_start(args, format);
-    vsprintf(buf, format, args);
+    fc_vformat(fc_putc, format, args);
     va_end(args);
-    fc_puts(buf);
 }
 
 void fc_clrscr()
@@ -830,6 +1400,81 @@ void fc_resetwin()
     gCurrentWin->textcolor = 5;
 }
 
+textwin *fc_pushWin(byte x0, byte y0, byte width, byte height)
+{
+    saveUnder *su;
+    word rowBytes;
+    word planeSize;
+    himemPtr offset;
+
+    if (x0 >= gScreenColumns || y0 >= gScreenRows || width == 0 || height == 0)
+    {
+        return NULL;
+    }
+    if (width > gScreenColumns - x0)
+    {
+        width = gScreenColumns - x0;
+    }
+    if (height > gScreenRows - y0)
+    {
+        height = gScreenRows - y0;
+    }
+    rowBytes = width * 2;
+    planeSize = rowBytes * height;
+    if (saveCount == MAX_SAVEUNDER ||
+        nextFreeSaveMem + (planeSize * 2) > SAVEUNDERBASE + SAVEUNDERSIZE)
+    {
+        fc_fatal("save-under overflow");
+    }
+
+    su = &saveStack[saveCount++];
+    su->saveAdr = nextFreeSaveMem;
+    su->prevWin = gCurrentWin;
+    nextFreeSaveMem += planeSize * 2;
+
+    offset = cellOffset(x0, y0);
+    lcopy_rect(gScreenBase + offset, su->saveAdr, rowBytes, height,
+               gScreenRowBytes, rowBytes);
+    lcopy_rect(gColourBase + offset, su->saveAdr + planeSize, rowBytes, height,
+               gScreenRowBytes, rowBytes);
+
+    su->win.x0 = x0;
+    su->win.y0 = y0;
+    su->win.width = width;
+    su->win.height = height;
+    su->win.xc = 0;
+    su->win.yc = 0;
+    su->win.extAttributes = 0;
+    su->win.textcolor = gCurrentWin->textcolor;
+    gCurrentWin = &su->win;
+    return gCurrentWin;
+}
+
+void fc_popWin(void)
+{
+    saveUnder *su;
+    word rowBytes;
+    word planeSize;
+    himemPtr offset;
+
+    if (saveCount == 0)
+    {
+        return;
+    }
+    su = &saveStack[--saveCount];
+    rowBytes = su->win.width * 2;
+    planeSize = rowBytes * su->win.height;
+
+    offset = cellOffset(su->win.x0, su->win.y0);
+    lcopy_rect(su->saveAdr, gScreenBase + offset, rowBytes, su->win.height,
+               rowBytes, gScreenRowBytes);
+    lcopy_rect(su->saveAdr + planeSize, gColourBase + offset, rowBytes, su->win.height,
+               rowBytes, gScreenRowBytes);
+
+    nextFreeSaveMem = su->saveAdr;
+    gCurrentWin = su->prevWin;
+}
+
 void fc_setwin(textwin *aWin)
 {
     gCurrentWin = aWin;
@@ -852,87 +1497,331 @@ textwin *fc_makeWin(byte x0, byte y0, byte width, byte height)
 
 int fc_kbhit()
 {
-    // TODO: implement m65 native keyboard scan
-    return kbhit();
+    return keyHead != keyTail;
 }
 
 void fc_emptyBuffer(void)
 {
-    while (kbhit())
-    {
-        cgetc();
-    }
+    keyTail = keyHead;
+}
+
+byte fc_keymods(void)
+{
+    return lastKeyMods;
 }
 
 unsigned char fc_cgetc(void)
 {
-    return cgetc();
+    static byte c;
+
+    while (keyHead == keyTail)
+        ;
+    c = keyBuf[keyTail];
+    lastKeyMods = keyModBuf[keyTail];
+    keyTail = (keyTail + 1) & (KEYBUFSIZE - 1);
+
+    // the hardware queue delivers ascii; convert letters to petscii
+    // (numeric constants because cc65 translates character literals)
+    if (c >= 0x41 && c <= 0x5a)
+    {
+        c |= 0x80;
+    }
+    else if (c >= 0x61 && c <= 0x7a)
+    {
+        c -= 0x20;
+    }
+    return c;
 }
 
 char fc_getkey(void)
 {
     fc_emptyBuffer();
-    return cgetc();
+    return fc_cgetc();
 }
 
-int fc_getnum(byte maxlen)
+// ----------------------------------------------------------------------------
+// line editor
+// ----------------------------------------------------------------------------
+
+#define EDIT_NODIRT 0xff
+
+static void editDirty(lineEditor *ed, byte from, byte to)
 {
-    int res;
-    char *inptr;
-    inptr = fc_input(maxlen);
-    res = atoi(inptr);
-    free(inptr);
-    return res;
+    if (from < ed->dirtyFrom || ed->dirtyFrom == EDIT_NODIRT)
+    {
+        ed->dirtyFrom = from;
+    }
+    if (to > ed->dirtyTo || ed->dirtyTo == EDIT_NODIRT)
+    {
+        ed->dirtyTo = to;
+    }
 }
 
-char *fc_input(byte maxlen)
+static void editRedraw(lineEditor *ed)
 {
-    static byte len, ct;
-    char current;
-    char *ret;
-    len = 0;
-    ct = csrflag;
-    fc_cursor(1);
-    do
+    static word i;
+    static byte c;
+
+    // keep the cursor inside the visible part
+    if (ed->pos < ed->scroll)
+    {
+        ed->scroll = ed->pos;
+        editDirty(ed, ed->scroll, ed->scroll + ed->width - 1);
+    }
+    else if (ed->pos >= ed->scroll + ed->width)
+    {
+        ed->scroll = ed->pos - ed->width + 1;
+        editDirty(ed, ed->scroll, ed->scroll + ed->width - 1);
+    }
+
+    if (ed->dirtyFrom == EDIT_NODIRT)
+    {
+        return;
+    }
+
+    for (i = ed->dirtyFrom; i <= ed->dirtyTo; ++i)
     {
-        current = cgetc();
-        if (current != '\n')
+        if (i < ed->scroll || i >= ed->scroll + ed->width)
         {
-            if (current >= 32)
+            continue;
+        }
+        c = i < ed->len ? ed->buf[i] : ' ';
+        fc_plotPetsciiChar(ed->x + i - ed->scroll, ed->y, asciiToPetscii(c), ed->textcolor,
+                           (i == ed->pos && ed->cursor) ? ed->extAttributes ^ 0x20
+                                                        : ed->extAttributes);
+    }
+    ed->dirtyFrom = EDIT_NODIRT;
+    ed->dirtyTo = EDIT_NODIRT;
+}
+
+static void editHistory(lineEditor *ed, byte histPos)
+{
+    byte slot;
+
+    ed->histPos = histPos;
+    editDirty(ed, 0, ed->len);
+    if (histPos == 0)
+    {
+        ed->len = 0;
+    }
+    else
+    {
+        slot = (ed->histNext + ed->histCount - histPos) % ed->histCount;
+        strcpy(ed->buf, ed->history + (slot * (ed->maxlen + 1)));
+        ed->len = strlen(ed->buf);
+    }
+    ed->pos = ed->len;
+    editDirty(ed, 0, ed->len);
+}
+
+static void editRemember(lineEditor *ed)
+{
+    if (!ed->history || ed->len == 0)
+    {
+        return;
+    }
+    strcpy(ed->history + (ed->histNext * (ed->maxlen + 1)), ed->buf);
+    ed->histNext = (ed->histNext + 1) % ed->histCount;
+    if (ed->histUsed < ed->histCount)
+    {
+        ed->histUsed++;
+    }
+}
+
+void fc_editNewLine(lineEditor *ed, byte x, byte y)
+{
+    ed->len = 0;
+    ed->pos = 0;
+    ed->scroll = 0;
+    ed->x = gCurrentWin->x0 + x;
+    ed->y = gCurrentWin->y0 + y;
+    ed->textcolor = gCurrentWin->textcolor;
+    ed->extAttributes = gCurrentWin->extAttributes;
+    ed->insert = true;
+    ed->cursor = true;
+    ed->histPos = 0;
+    ed->dirtyFrom = EDIT_NODIRT;
+    ed->dirtyTo = EDIT_NODIRT;
+    ed->buf[0] = 0;
+    editDirty(ed, 0, ed->width - 1);
+    editRedraw(ed);
+}
+
+void fc_editInit(lineEditor *ed, char *buf, byte maxlen, byte x, byte y, byte width)
+{
+    if (maxlen > 254)
+    {
+        maxlen = 254; // 0xff marks 'nothing to redraw'
+    }
+    ed->buf = buf;
+    ed->maxlen = maxlen;
+    ed->width = width;
+    ed->history = NULL;
+    ed->histCount = 0;
+    ed->histUsed = 0;
+    ed->histNext = 0;
+    fc_editNewLine(ed, x, y);
+}
+
+void fc_editSetHistory(lineEditor *ed, char *history, byte count)
+{
+    if (history == ed->history && count == ed->histCount)
+    {
+        return; // keep the remembered lines
+    }
+    ed->history = history;
+    ed->histCount = count;
+    ed->histUsed = 0;
+    ed->histNext = 0;
+    ed->histPos = 0;
+}
+
+byte fc_editPump(lineEditor *ed)
+{
+    static byte c;
+
+    while (fc_kbhit())
+    {
+        c = fc_cgetc();
+        switch (c)
+        {
+        case KEY_RETURN:
+        case KEY_ESC:
+            ed->buf[ed->len] = 0;
+            ed->cursor = false;
+            editDirty(ed, ed->pos, ed->pos);
+            editRedraw(ed);
+            if (c == KEY_ESC)
             {
-                if (len < maxlen)
-                {
-                    fcbuf[len] = current;
-                    fcbuf[len + 1] = 0;
-                    fc_putc(current);
-                    ++len;
-                }
+                return EDIT_ESCAPE;
+            }
+            editRemember(ed);
+            return EDIT_RETURN;
+
+        case KEY_DEL:
+            if (ed->pos > 0)
+            {
+                memmove(ed->buf + ed->pos - 1, ed->buf + ed->pos, ed->len - ed->pos);
+                ed->len--;
+                ed->pos--;
+                editDirty(ed, ed->pos, ed->len + 1);
+            }
+            break;
+
+        case KEY_INST:
+            ed->insert = !ed->insert;
+            break;
+
+        case KEY_LEFT:
+            if (ed->pos > 0)
+            {
+                editDirty(ed, ed->pos - 1, ed->pos);
+                ed->pos--;
+            }
+            break;
+
+        case KEY_RIGHT:
+            if (ed->pos < ed->len)
+            {
+                editDirty(ed, ed->pos, ed->pos + 1);
+                ed->pos++;
+            }
+            break;
+
+        case KEY_HOME:
+            editDirty(ed, 0, ed->pos);
+            ed->pos = 0;
+            break;
+
+        case KEY_CLR:
+            editDirty(ed, 0, ed->len);
+            ed->len = 0;
+            ed->pos = 0;
+            break;
+
+        case KEY_UP:
+            if (ed->histPos < ed->histUsed)
+            {
+                editHistory(ed, ed->histPos + 1);
+            }
+            break;
+
+        case KEY_DOWN:
+            if (ed->histPos > 0)
+            {
+                editHistory(ed, ed->histPos - 1);
             }
-            else if (current == 20)
+            break;
+
+        default:
+            if (c < 32 || (c >= 128 && c < 160))
             {
-                // del pressed
-                if (len > 0)
+                break; // other control codes
+            }
+            if (ed->insert || ed->pos == ed->len)
+            {
+                if (ed->len >= ed->maxlen)
                 {
-                    fc_cursor(0);
-                    fc_gotoxy(gCurrentWin->xc - 1, gCurrentWin->yc);
-                    fc_putc(' ');
-                    fc_gotoxy(gCurrentWin->xc - 1, gCurrentWin->yc);
-                    fc_cursor(1);
-                    --len;
+                    break;
                 }
+                memmove(ed->buf + ed->pos + 1, ed->buf + ed->pos, ed->len - ed->pos);
+                ed->len++;
+                editDirty(ed, ed->pos, ed->len);
+            }
+            else
+            {
+                editDirty(ed, ed->pos, ed->pos + 1);
             }
+            ed->buf[ed->pos++] = c;
+            break;
         }
-    } while (current != '\n');
-    ret = (char *)malloc(++len);
-    if (len == 1)
+    }
+    ed->buf[ed->len] = 0;
+    editRedraw(ed);
+    return EDIT_ACTIVE;
+}
+
+byte fc_inputBuf(char *buf, byte maxlen)
+{
+    static lineEditor ed;
+    static byte width;
+    byte res;
+
+    if (maxlen > 254)
     {
-        *ret = 0;
+        maxlen = 254;
     }
-    else
+    width = gCurrentWin->width - gCurrentWin->xc;
+    if (width > maxlen + 1)
     {
-        strncpy(ret, fcbuf, len);
+        width = maxlen + 1;
     }
-    fc_cursor(ct);
+    fc_editInit(&ed, buf, maxlen, gCurrentWin->xc, gCurrentWin->yc, width);
+    do
+    {
+        res = fc_editPump(&ed);
+    } while (res == EDIT_ACTIVE);
+
+    gCurrentWin->xc += ed.len - ed.scroll;
+    return ed.len;
+}
+
+int fc_getnum(byte maxlen)
+{
+    char numbuf[8];
+    if (maxlen > sizeof(numbuf) - 1)
+    {
+        maxlen = sizeof(numbuf) - 1;
+    }
+    fc_inputBuf(numbuf, maxlen);
+    return atoi(numbuf);
+}
+
+char *fc_input(byte maxlen)
+{
+    char *ret;
+    ret = (char *)malloc(fc_inputBuf(fcbuf, maxlen) + 1);
+    strcpy(ret, fcbuf);
     return ret;
 }
 
@@ -940,13 +1829,13 @@ void fc_line(byte x, byte y, byte width, byte character, byte col)
 {
     word bas;
 
-    bas = (gCurrentWin->x0 + x) * 2 + ((gCurrentWin->y0 + y) * gScreenColumns * 2);
+    bas = cellOffset(gCurrentWin->x0 + x, gCurrentWin->y0 + y);
 
     // use DMAgic to fill FCM screens with skip byte... PGS, I love you!
-    lfill_skip(SCREENBASE + bas, character, width, 2);
-    lfill_skip(SCREENBASE + bas + 1, 0, width, 2);
-    lfill_skip(COLBASE + bas, 0, width, 2);
-    lfill_skip(COLBASE + bas + 1, col, width, 2);
+    lfill_skip(gScreenBase + bas, character, width, 2);
+    lfill_skip(gScreenBase + bas + 1, 0, width, 2);
+    lfill_skip(gColourBase + bas, 0, width, 2);
+    lfill_skip(gColourBase + bas + 1, col, width, 2);
 
     return;
 }
@@ -996,7 +1885,7 @@ char fc_getkeyP(byte x, byte y, const char *prompt)
     fc_gotoxy(x, y);
     fc_textcolor(COLOR_WHITE);
     fc_puts(prompt);
-    return cgetc();
+    return fc_cgetc();
 }
 
 void fc_hlinexy(byte x, byte y, byte width, byte lineChar)
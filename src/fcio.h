@@ -9,6 +9,7 @@
 #define __FCIO
 
 #include "memory.h"
+#include <stdarg.h>
 #include <stdbool.h>
 
 #ifndef __FCIO_VARS
@@ -17,8 +18,24 @@
 #define EXTCHARBASE 0x14000l // 'reserved' graphics for extended characters
 #define SYSPAL 0x15000l      // system palette
 #define PALBASE 0x15300l     // palettes for loaded images
+#define SPRITEBASE 0x1f000l  // hardware sprite pointers and shapes
 #define GRAPHBASE 0x40000l   // bitmap characters
+#define ATLASBASE 0x5c000l   // runtime allocated extended characters (top of graphics memory)
+#define ATLASSLOTS 256       // number of 64 byte slots in the atlas
 #define COLBASE 0xff81000l   // colours
+#define SAVEUNDERBASE 0x8000000l // save-under buffers for popup windows (attic RAM)
+#define SAVEUNDERSIZE 0x10000l
+#define WMSTOREBASE 0x8010000l  // window manager backing stores (attic RAM)
+#define WMSTORESIZE 0x5000l     // per window: screen and colour cells of up to 80x64
+#define TILEMAPBASE 0x8060000l  // tile map (attic RAM, up to 64K)
+#define SCROLLBACKBASE 0x8070000l // scrollback buffers (attic RAM)
+#define SCROLLBACKSIZE 0x100000l
+#define PAGERBASE 0x8170000l    // pager document (attic RAM, up to 64K when loaded)
+#define PAGERLINES 0x8180000l   // pager line table (attic RAM, 256K)
+#define ANIMBASE 0x81c0000l     // animation frames when loaded (attic RAM)
+#define ANIMSIZE 0x200000l
+#define ANIMSTAGE 0x83c0000l    // animation frame read ahead when streaming (attic RAM)
+#define ANIMSTAGESIZE 0x40000l
 #endif
 
 #define FCBUFSIZE 0xff
@@ -48,6 +65,7 @@ typedef struct _fciInfo
     byte columns;            ///< number of character columns for image
     byte rows;               ///< number of character rows
     word size;               ///< size of bitmap
+    bool ncm;                ///< nibble colour mode image (16x8 pixels per character)
 } fciInfo;
 
 typedef struct _textwin
@@ -65,6 +83,10 @@ typedef struct _textwin
 extern byte gScreenColumns;  ///< number of screen columns (in characters)
 extern byte gScreenRows;     ///< number of screen rows (in characters)
 extern textwin *gCurrentWin; ///< current window
+extern himemPtr gScreenBase; ///< screen memory of the current screen region
+extern himemPtr gColourBase; ///< colour memory of the current screen region
+extern word gScreenRowBytes;  ///< bytes per row of screen and colour memory
+extern byte gGraphGeneration; ///< changes whenever graphic areas are freed
 
 // --- general & initializations ---
 
@@ -84,6 +106,8 @@ void fc_init(byte h640, byte v400, byte rows, char *bordersFilename);
  * @param h640 horizontal resolution; true: 640px, false: 320px
  * @param v400 vertical resolution; true: 400px, false: 200px
  * @param rows character rows (or 0 for standard configuration)
+ * 
+ * Removes a split screen set up with @a fc_splitScreen.
  */
 void fc_screenmode(byte h640, byte v400, byte rows);
 
@@ -138,12 +162,528 @@ void fc_hlinexy(byte x, byte y, byte width, byte lineChar);
 void fc_vlinexy(byte x, byte y, byte height, byte lineChar);
 void fc_line(byte x, byte y, byte width, byte character, byte col);
 
+/**
+ * @brief smoothly scroll the whole screen
+ * 
+ * @param dy pixels to scroll; positive values move the contents up
+ * @param speed pixels per frame (1-8)
+ * 
+ * Returns at once, the scrolling is done by the raster interrupt using
+ * the text y position register. The screen memory is only moved (by a
+ * whole row) when the fine offset wraps. While scrolling, the row below
+ * the screen is displayed as well: put what should scroll in there
+ * (or into row 0 when scrolling down), or let a feeder do it.
+ * Calls add up; the screen must have a free row after the last one.
+ */
+void fc_smoothScroll(int dy, byte speed);
+
+/**
+ * @brief check if smooth scrolling is still in progress
+ * 
+ * @return true if there are pixels left to scroll
+ */
+bool fc_smoothScrolling(void);
+
+/**
+ * @brief set function to fill rows that scroll into view
+ * 
+ * @param feeder called with the screen row to fill (0 or the row below
+ *               the screen) after each whole-row move, or NULL
+ * 
+ * @warning The feeder runs in interrupt context: it may write to screen
+ *          memory (the DMA job list and the math unit are saved around
+ *          it), but must not touch the current window or fcbuf.
+ */
+void fc_setScrollFeeder(void (*feeder)(byte row));
+
+// ----------------------------------------------------------------------------
+// raster interrupt scheduler
+// ----------------------------------------------------------------------------
+
+// fc_init installs a raster interrupt. Once per frame, in the vertical
+// blank below the bottom border, it counts the frame and runs the
+// deferred jobs queued with the fc_defer... functions, in order.
+// Deferred jobs and raster handlers run in interrupt context; the
+// DMA job list and the math unit inputs are saved around them, so they
+// may use DMA and the math unit.
+
+/**
+ * @brief number of frames since fc_init (wraps around)
+ * 
+ * @return word frame count
+ */
+word fc_frames(void);
+
+/**
+ * @brief wait a number of frames
+ * 
+ * @param n number of frames (50 per second on PAL, 60 on NTSC)
+ */
+void fc_waitFrames(word n);
+
+/**
+ * @brief wait until the next vertical blank has begun
+ * 
+ */
+void fc_waitVBlank(void);
+
+/**
+ * @brief call function at raster line every frame
+ * 
+ * @param line raster line (VIC-II numbering, 0-311)
+ * @param handler function to call
+ * @return true if added, false if all 8 slots are used
+ */
+bool fc_addRasterHandler(word line, void (*handler)(void));
+
+/**
+ * @brief stop calling raster handler
+ * 
+ * @param handler function passed to @a fc_addRasterHandler
+ */
+void fc_removeRasterHandler(void (*handler)(void));
+
+/**
+ * @brief write register (or low memory) in the next vertical blank
+ * 
+ * @param adr address
+ * @param value value to write
+ * 
+ * The queue holds 31 jobs; when it's full, the fc_defer functions wait
+ * for the next vertical blank.
+ */
+void fc_deferPoke(word adr, byte value);
+
+/**
+ * @brief DMA copy in the next vertical blank
+ * 
+ * @param src source address
+ * @param dst destination address
+ * @param count number of bytes
+ * 
+ * The source must not change before the job has run (see @a fc_waitVBlank).
+ */
+void fc_deferCopy(himemPtr src, himemPtr dst, word count);
+
+/**
+ * @brief DMA fill in the next vertical blank
+ * 
+ * @param dst destination address
+ * @param value fill value
+ * @param count number of bytes
+ */
+void fc_deferFill(himemPtr dst, byte value, word count);
+
+/**
+ * @brief set palette entry in the next vertical blank
+ * 
+ * @param num palette entry
+ * @param red red value
+ * @param green green value
+ * @param blue blue value
+ */
+void fc_deferPalette(byte num, byte red, byte green, byte blue);
+
+/**
+ * @brief call function in the next vertical blank
+ * 
+ * @param fn function to call
+ */
+void fc_deferCall(void (*fn)(void));
+
+// ----------------------------------------------------------------------------
+// split screen
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief split the screen into regions with different text modes
+ *
+ * @param row first screen row of the new region (below the last one)
+ * @param h640 true for 80 columns, false for 40 in the new region
+ * @return byte number of the new region, or 0 if it couldn't be added
+ *
+ * The first call makes the screen as set up by @a fc_screenmode region 0
+ * and cuts a new region off its bottom; further calls cut the lowest
+ * region again (max. 4 regions). The new region is cleared. Each region
+ * has its own screen memory, geometry and window; use @a fc_selectRegion
+ * to direct output to it. The mode switches are done by raster handlers,
+ * so a long DMA job running at a split line can delay it.
+ */
+byte fc_splitScreen(byte row, bool h640);
+
+/**
+ * @brief direct all output to a screen region
+ *
+ * @param region region number as returned by @a fc_splitScreen (0 for the top)
+ *
+ * Sets the screen geometry to the region's size and makes the
+ * region's window current.
+ */
+void fc_selectRegion(byte region);
+
+/**
+ * @brief remove all splits and go back to one clear screen
+ *
+ */
+void fc_unsplitScreen(void);
+
+// ----------------------------------------------------------------------------
+// scrollback
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief keep the lines scrolled out of a window
+ *
+ * @param w window
+ * @param lines number of lines to keep; the oldest ones are dropped
+ * @return true if the buffer was set up, false if attic RAM or the
+ *         4 buffer slots are used up
+ *
+ * From now on, @a fc_scrollUp saves the top line of @a w (screen and
+ * colour cells) in a ring in attic RAM before scrolling it away.
+ * The window must not change its size while a buffer is attached.
+ */
+bool fc_sbAttach(textwin *w, word lines);
+
+/**
+ * @brief stop keeping lines for a window and drop the ones kept
+ *
+ * @param w window
+ */
+void fc_sbDetach(textwin *w);
+
+/**
+ * @brief scroll a window's view back into its scrollback buffer
+ *
+ * @param w window
+ * @param lines number of lines to go back, negative values go forward
+ *
+ * The window contents are restored when the view comes back to the end,
+ * with @a fc_sbEnd, or when the window scrolls because of new output.
+ * Don't print into the window while its view is scrolled back.
+ */
+void fc_sbScroll(textwin *w, int lines);
+
+/**
+ * @brief scroll a window's view back by one page
+ *
+ * @param w window
+ */
+void fc_sbPageUp(textwin *w);
+
+/**
+ * @brief scroll a window's view forward by one page
+ *
+ * @param w window
+ */
+void fc_sbPageDown(textwin *w);
+
+/**
+ * @brief show the current window contents again
+ *
+ * @param w window
+ */
+void fc_sbEnd(textwin *w);
+
+/**
+ * @brief get number of lines kept for a window
+ *
+ * @param w window
+ * @return word number of lines in the scrollback buffer
+ */
+word fc_sbLines(textwin *w);
+
+// ----------------------------------------------------------------------------
+// pager
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief set document to show with the pager
+ *
+ * @param text address of the document (petscii, lines end with '\n')
+ * @param size document size in bytes
+ *
+ * The document stays where it is; don't change it while it's open.
+ */
+void fc_pgOpen(himemPtr text, long size);
+
+/**
+ * @brief load document into attic RAM and open it in the pager
+ *
+ * @param filename file name
+ *
+ * Stops with an error if the document is longer than 64K.
+ */
+void fc_pgLoad(char *filename);
+
+/**
+ * @brief word wrap the document
+ *
+ * @param width line width in characters
+ * @return word number of lines
+ *
+ * Called by @a fc_pgShow when the width of the current window differs
+ * from the last one, so there's usually no need to call it directly.
+ * Takes time proportional to the document size.
+ */
+word fc_pgWrap(byte width);
+
+/**
+ * @brief show the document in the current window
+ *
+ * @param line first line to show
+ *
+ * Only the visible lines are read, so this is equally fast for any line.
+ */
+void fc_pgShow(word line);
+
+/**
+ * @brief scroll the document in the current window
+ *
+ * @param lines number of lines, negative values scroll back
+ */
+void fc_pgScroll(int lines);
+
+/**
+ * @brief get number of lines of the wrapped document
+ *
+ * @return word number of lines
+ */
+word fc_pgLines(void);
+
+/**
+ * @brief get first line shown
+ *
+ * @return word line number
+ */
+word fc_pgTop(void);
+
+// ----------------------------------------------------------------------------
+// animations
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief open an animation written by png2fci -a and show its first frame
+ *
+ * @param filename fca file
+ * @param stream read frames from disk while playing instead of loading
+ *               the whole animation into attic RAM first
+ * @param x0 x origin (in characters)
+ * @param y0 y origin (in characters)
+ * @return true if opened, false if the file is missing, isn't a version 1
+ *         fca file or there's no room for it (without @a stream, the
+ *         deltas must fit into 2 MB of attic RAM)
+ *
+ * Sets the palette of the animation. The characters are taken from
+ * graphic memory, like those of a loaded FCI image. Only one animation
+ * can be open at a time.
+ */
+bool fc_animOpen(char *filename, bool stream, byte x0, byte y0);
+
+/**
+ * @brief start or continue playing the open animation
+ *
+ * @param loop start over after the last frame
+ *
+ * Frames are changed in the vertical blank, at the rate stored in the
+ * file (see @a fc_animSetDelay). Only the characters and screen cells
+ * that differ from the previous frame are updated.
+ */
+void fc_animPlay(bool loop);
+
+/**
+ * @brief read ahead the next frame of a streamed animation
+ *
+ * @return true while the animation is playing
+ *
+ * Call often while playing a streamed animation; a frame is shown late
+ * if it wasn't read in time. Does nothing for animations in attic RAM,
+ * but can be used to wait for them to finish.
+ */
+bool fc_animUpdate(void);
+
+/**
+ * @brief stop playing, keeping the current frame on screen
+ *
+ */
+void fc_animStop(void);
+
+/**
+ * @brief change the frame rate
+ *
+ * @param vblanks number of vertical blanks to show each frame
+ */
+void fc_animSetDelay(byte vblanks);
+
+/**
+ * @brief stop playing and close the animation file
+ *
+ * The frame stays on screen; its characters are freed with the other
+ * graphic areas (see @a fc_freeGraphAreas).
+ */
+void fc_animClose(void);
+
+// ----------------------------------------------------------------------------
+// virtual consoles
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief set up virtual consoles
+ *
+ * @param count number of consoles wanted, including the screen (max. 4)
+ * @return byte number of consoles available
+ *
+ * Console 0 is the current screen. Each other console gets a cleared
+ * screen of the same size in graphic memory and its own part of colour
+ * RAM; fewer consoles are set up if graphic memory or colour RAM runs
+ * out (80x50 screens leave room for 3). Call once, after setting the screen mode and before loading
+ * images; don't combine with overlays, split screens or the tile map.
+ */
+byte fc_initConsoles(byte count);
+
+/**
+ * @brief direct all output to a console
+ *
+ * @param n console number
+ *
+ * The console doesn't have to be visible. Each console remembers its
+ * current window, which is made current again when it's selected.
+ */
+void fc_selectConsole(byte n);
+
+/**
+ * @brief show a console
+ *
+ * @param n console number
+ *
+ * The display switches in the next vertical blank. Which console
+ * receives output doesn't change.
+ */
+void fc_switchConsole(byte n);
+
+/**
+ * @brief get the console being shown
+ *
+ * @return byte console number
+ */
+byte fc_visibleConsole(void);
+
+// ----------------------------------------------------------------------------
+// overlays
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief set up an overlay layer over the screen
+ *
+ * @param x0 first screen column covered by the overlay
+ * @param width overlay width in characters
+ * @return true if the overlay was set up, false if there's no graphic
+ *         memory left for the widened screen or it's already set up
+ *
+ * Every screen row gets @a width extra cells which the raster rewrite
+ * buffer draws over the normal ones. Whatever is drawn into the overlay
+ * leaves the screen below it untouched; the background of overlay
+ * characters is transparent. The VIC only has time for a limited number
+ * of cells per raster line, so keep overlays narrow in 80 column mode.
+ * Don't combine with @a fc_splitScreen or the tile map engine.
+ */
+bool fc_ovlInit(byte x0, byte width);
+
+/**
+ * @brief remove the overlay layer
+ *
+ * Call this before changing the screen mode. The graphic memory used for
+ * the widened screen is only given back by @a fc_freeGraphAreas.
+ */
+void fc_ovlDone(void);
+
+/**
+ * @brief write text into the overlay
+ *
+ * @param x overlay column
+ * @param y screen row
+ * @param colour text colour
+ * @param s text
+ */
+void fc_ovlPutsxy(byte x, byte y, byte colour, const char *s);
+
+/**
+ * @brief plot a full colour character into the overlay
+ *
+ * @param x overlay column
+ * @param y screen row
+ * @param charIdx character number (address / 64)
+ *
+ * Pixels of colour 0 are transparent.
+ */
+void fc_ovlPlotCharIdx(byte x, byte y, word charIdx);
+
+/**
+ * @brief clear part of the overlay, showing the screen below again
+ *
+ * @param x overlay column
+ * @param y screen row
+ * @param width width in characters
+ * @param height height in characters
+ */
+void fc_ovlClear(byte x, byte y, byte width, byte height);
+
+/**
+ * @brief move the overlay of one row horizontally
+ *
+ * @param y screen row
+ * @param px pixel position of overlay column 0 (initially x0 * 8)
+ */
+void fc_ovlSetPos(byte y, word px);
+
 // ----------------------------------------------------------------------------
 // --- keyboard input ---
 // ----------------------------------------------------------------------------
 
+// modifier bits as returned by fc_keymods
+#define KEYMOD_RSHIFT 0x01
+#define KEYMOD_LSHIFT 0x02
+#define KEYMOD_CTRL 0x04
+#define KEYMOD_MEGA 0x08
+#define KEYMOD_ALT 0x10
+#define KEYMOD_NOSCRL 0x20
+#define KEYMOD_CAPSLOCK 0x40
+
+/**
+ * @brief discard all pending keystrokes
+ * 
+ * Keys are read from the MEGA65 hardware keyboard queue by an interrupt
+ * handler (installed by @a fc_init) into a ring buffer, so nothing gets
+ * lost while fcio is busy with long DMA jobs or disc access.
+ */
 void fc_emptyBuffer(void);
+
+/**
+ * @brief wait for and return next key from the keyboard buffer
+ * 
+ * @return unsigned char petscii code of key
+ */
 unsigned char fc_cgetc(void);
+
+/**
+ * @brief get modifier keys held down with the last key read
+ * 
+ * @return byte combination of KEYMOD_* bits
+ */
+byte fc_keymods(void);
+
+// petscii codes of editing keys
+#define KEY_RETURN 13
+#define KEY_ESC 27
+#define KEY_DEL 20
+#define KEY_INST 148
+#define KEY_HOME 19
+#define KEY_CLR 147
+#define KEY_LEFT 157
+#define KEY_RIGHT 29
+#define KEY_UP 145
+#define KEY_DOWN 17
+
 char fc_getkey(void);
 char fc_getkeyP(byte x, byte y, const char *prompt);
 
@@ -152,11 +692,103 @@ char fc_getkeyP(byte x, byte y, const char *prompt);
  * 
  * @param maxlen maximum length
  * @return char* a newly allocated area in memory containing the input string
+ * 
+ * The caller has to free the result. Prefer @a fc_inputBuf, which
+ * doesn't allocate anything.
  */
 char *fc_input(byte maxlen);
+
+/**
+ * @brief get user input into caller provided buffer
+ * 
+ * @param buf buffer for input (at least @a maxlen + 1 bytes)
+ * @param maxlen maximum length
+ * @return byte length of input
+ */
+byte fc_inputBuf(char *buf, byte maxlen);
 int fc_getnum(byte maxlen);
 int fc_kbhit();
 
+// ----------------------------------------------------------------------------
+// --- line editor ---
+// ----------------------------------------------------------------------------
+
+typedef struct _lineEditor
+{
+    char *buf;          ///< caller provided buffer (maxlen + 1 bytes)
+    byte maxlen;        ///< maximum input length
+    byte len;           ///< current input length
+    byte pos;           ///< cursor position in buffer
+    byte scroll;        ///< first visible buffer position
+    byte x;             ///< screen column of input field
+    byte y;             ///< screen row of input field
+    byte width;         ///< visible width of input field
+    byte textcolor;     ///< text colour
+    byte extAttributes; ///< extended text attributes
+    bool insert;        ///< insert (true) or overwrite mode
+    bool cursor;        ///< cursor visible
+    char *history;      ///< caller provided history slots (histCount * (maxlen + 1) bytes) or NULL
+    byte histCount;     ///< number of history slots
+    byte histUsed;      ///< number of used history slots
+    byte histNext;      ///< next history slot to write
+    byte histPos;       ///< history browsing position (0 = current input)
+    byte dirtyFrom;     ///< first buffer position to redraw
+    byte dirtyTo;       ///< last buffer position to redraw
+} lineEditor;
+
+// fc_editPump results
+#define EDIT_ACTIVE 0
+#define EDIT_RETURN 1
+#define EDIT_ESCAPE 2
+
+/**
+ * @brief set up line editor at given position in current window
+ * 
+ * @param ed editor to initialize
+ * @param buf buffer for input (at least @a maxlen + 1 bytes)
+ * @param maxlen maximum input length (max. 254)
+ * @param x x position
+ * @param y y position
+ * @param width visible width; longer input scrolls horizontally
+ * 
+ * Forgets any attached history; use @a fc_editNewLine for the next
+ * line of the same input.
+ */
+void fc_editInit(lineEditor *ed, char *buf, byte maxlen, byte x, byte y, byte width);
+
+/**
+ * @brief start editing a new, empty line, keeping buffer, width and history
+ * 
+ * @param ed editor set up with @a fc_editInit
+ * @param x x position in current window
+ * @param y y position in current window
+ */
+void fc_editNewLine(lineEditor *ed, byte x, byte y);
+
+/**
+ * @brief attach history storage to line editor
+ * 
+ * @param ed editor
+ * @param history storage for @a count lines of @a ed->maxlen + 1 bytes
+ * @param count number of history lines
+ * 
+ * Attaching the same storage again keeps the remembered lines.
+ */
+void fc_editSetHistory(lineEditor *ed, char *history, byte count);
+
+/**
+ * @brief process pending keys and redraw changed cells
+ * 
+ * Never blocks, so it can be called once per frame from a main loop
+ * which keeps animating other things. Supports cursor left/right,
+ * home, clr, del, inst (insert/overwrite toggle) and cursor up/down
+ * for browsing the history.
+ * 
+ * @param ed editor
+ * @return byte EDIT_ACTIVE while editing, EDIT_RETURN or EDIT_ESCAPE when done
+ */
+byte fc_editPump(lineEditor *ed);
+
 // ----------------------------------------------------------------------------
 // --- string and character output ---
 // ----------------------------------------------------------------------------
@@ -202,63 +834,141 @@ void fc_putcxy(byte x, byte y, char c);
 /**
  * @brief print string at current cursor position
  * 
- * @param format format string
- * @param ... format parameters
+ * Characters are written as they are formatted, so there is no length
+ * limit. Supports %c, %s, %d, %i, %u, %x, %X and %%, optionally with
+ * field width, '-' for left alignment and '0' for zero padding.
+ * 
+ * @param format format string
+ * @param ... format parameters
+ */
+void fc_printf(const char *format, ...);
+
+/**
+ * @brief format string with fc_printf semantics into output function
+ * 
+ * @param out function receiving each output character
+ * @param format format string
+ * @param args format parameters
+ */
+void fc_vformat(void (*out)(char), const char *format, va_list args);
+
+/**
+ * @brief set cursor position in current window
+ * 
+ * @param x 
+ * @param y 
+ */
+void fc_gotoxy(byte x, byte y);
+
+/**
+ * @brief get cursor x position
+ * 
+ * @return byte cursor y position
+ */
+byte fc_wherex();
+
+/**
+ * @brief get cursor y position
+ * 
+ * @return byte cursor y position
+ */
+byte fc_wherey();
+
+/**
+ * @brief set active window
+ * 
+ * @param aWin window to activate
+ */
+void fc_setwin(textwin *aWin);
+
+/**
+ * @brief convenience method to create a window structure
+ * 
+ * @param x0 x origin
+ * @param y0 y origin
+ * @param width window width
+ * @param height window height
+ * @return textwin* the created window structure
+ */
+textwin *fc_makeWin(byte x0, byte y0, byte width, byte height);
+
+/**
+ * @brief reset text window to whole screen
+ * 
+ */
+void fc_resetwin();
+
+/**
+ * @brief open popup window, saving the screen area beneath it
+ * 
+ * @param x0 x origin
+ * @param y0 y origin
+ * @param width window width
+ * @param height window height
+ * @return textwin* the popup window, which is also made the current window,
+ *         or NULL if the window is empty or off the screen
+ * 
+ * Screen and colour cells under the window are copied to attic RAM
+ * (one chained DMA job list per plane) and put back by @a fc_popWin, so
+ * closing a popup doesn't require redrawing what was beneath it.
+ * Windows reaching past the screen edge are clipped. Popups nest up to
+ * 8 levels deep.
  */
-void fc_printf(const char *format, ...);
+textwin *fc_pushWin(byte x0, byte y0, byte width, byte height);
 
 /**
- * @brief set cursor position in current window
+ * @brief close topmost popup window and restore the screen area beneath it
  * 
- * @param x 
- * @param y 
+ * The window that was current before the matching @a fc_pushWin
+ * becomes current again.
  */
-void fc_gotoxy(byte x, byte y);
+void fc_popWin(void);
 
 /**
- * @brief get cursor x position
+ * @brief cursor control
  * 
- * @return byte cursor y position
+ * @param onoff 1=on, 0=off
+ * 
+ * The cursor is a blinking hardware sprite (sprite 0) which follows the
+ * cursor position of the current window by itself, so it never changes
+ * screen memory.
  */
-byte fc_wherex();
+void fc_cursor(byte onoff);
 
 /**
- * @brief get cursor y position
+ * @brief show mouse pointer and start reading a 1351 mouse in port 1
  * 
- * @return byte cursor y position
+ * The pointer is hardware sprite 1. Position and buttons are updated
+ * once per frame by the raster interrupt.
  */
-byte fc_wherey();
+void fc_mouseInit(void);
 
 /**
- * @brief set active window
+ * @brief hide mouse pointer and stop reading the mouse
  * 
- * @param aWin window to activate
  */
-void fc_setwin(textwin *aWin);
+void fc_mouseDone(void);
 
 /**
- * @brief convenience method to create a window structure
+ * @brief mouse x position
  * 
- * @param x0 x origin
- * @param y0 y origin
- * @param width window width
- * @param height window height
- * @return textwin* the created window structure
+ * @return int x position in screen pixels (0-319 or 0-639)
  */
-textwin *fc_makeWin(byte x0, byte y0, byte width, byte height);
+int fc_mouseX(void);
 
 /**
- * @brief reset text window to whole screen
+ * @brief mouse y position
  * 
+ * @return int y position in screen pixels
  */
-void fc_resetwin();
+int fc_mouseY(void);
 
 /**
- * @brief cursor control
+ * @brief mouse buttons
  * 
- * @param onoff 1=on, 0=off
+ * @return byte bit 0: left button, bit 1: right button
  */
-void fc_cursor(byte onoff);
+byte fc_mouseButtons(void);
 
 /**
  * @brief center string at given position
@@ -282,6 +992,63 @@ void fc_scrollUp();
  */
 void fc_scrollDown();
 
+// ----------------------------------------------------------------------------
+// window manager
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief initialize window manager
+ * 
+ * Takes a snapshot of the current screen as desktop, which is shown
+ * wherever no managed window covers it. Call again after changing the
+ * screen mode or redrawing the desktop.
+ */
+void fc_wmInit(void);
+
+/**
+ * @brief open managed window on top of all others
+ * 
+ * @param x0 x origin
+ * @param y0 y origin
+ * @param width window width
+ * @param height window height
+ * @return textwin* the new window, which is cleared and made current
+ * 
+ * Up to 12 windows can be open. Each one has its own backing store in
+ * attic RAM. Only draw into the topmost window: the others get their
+ * contents repainted from their backing stores when uncovered.
+ */
+textwin *fc_wmOpen(byte x0, byte y0, byte width, byte height);
+
+/**
+ * @brief close managed window, repainting the area it covered
+ * 
+ * @param w window to close
+ */
+void fc_wmClose(textwin *w);
+
+/**
+ * @brief bring managed window to front and make it current
+ * 
+ * Only the parts of @a w that were covered by other windows get
+ * repainted.
+ * 
+ * @param w window to raise
+ */
+void fc_wmRaise(textwin *w);
+
+/**
+ * @brief move managed window (raising it first)
+ * 
+ * Only the rectangles uncovered by the move are repainted from the
+ * windows beneath.
+ * 
+ * @param w window to move
+ * @param x0 new x origin
+ * @param y0 new y origin
+ */
+void fc_wmMove(textwin *w, byte x0, byte y0);
+
 // ----------------------------------------------------------------------------
 // colour, attributes and palette handling
 // ----------------------------------------------------------------------------
@@ -395,6 +1162,17 @@ void fc_textcolor(byte c);
  */
 void fc_freeGraphAreas(void);
 
+/**
+ * @brief allocate graphic memory
+ * 
+ * @param size number of bytes
+ * @return himemPtr start address, or 0 if out of graphic memory
+ * 
+ * Areas never cross a bank boundary and are all given back at once by
+ * @a fc_freeGraphAreas.
+ */
+himemPtr fc_allocGraphMem(word size);
+
 /**
  * @brief Adds a graphics rectangle to the screen.
  * 
@@ -411,6 +1189,25 @@ void fc_freeGraphAreas(void);
 void fc_addGraphicsRect(byte x0, byte y0, byte width, byte height,
                         himemPtr bitmapData);
 
+/**
+ * @brief Adds a nibble colour mode graphics rectangle to the screen.
+ * 
+ * @param x0 x origin (in characters)
+ * @param y0 y origin (in characters)
+ * @param width width (in 16 pixel wide ncm characters)
+ * @param height height (in characters)
+ * @param bitmapData address of bitmap data
+ * @param colourBank palette bank (0-15) holding the 16 image colours
+ * 
+ * NCM characters are 16 pixels wide, so the rectangle covers
+ * 2 * @a width screen columns. Each row consists of @a width ncm
+ * characters followed by @a width GOTOX cells which keep the
+ * characters right of the image at their usual position. Don't
+ * print into the covered area unless you want to get rid of the image.
+ */
+void fc_addNCMGraphicsRect(byte x0, byte y0, byte width, byte height,
+                           himemPtr bitmapData, byte colourBank);
+
 /**
  * @brief allocate memory for FCI file and load it
  *
@@ -426,7 +1223,13 @@ void fc_addGraphicsRect(byte x0, byte y0, byte width, byte height,
  * When automatically alloacting graphic areas, it is quite possible to run 
  * out of memory. Therefore, it is advisable to always clear previously allocated
  * graphic areas with @a fc_freeGraphicAreas after usage.
- * 
+ *
+ * Shared palette files written by png2fci's -s mode are FCIs without
+ * bitmap data; load them with this function as well and upload them with
+ * @a fc_loadFCIPalette. The images belonging to the shared palette carry
+ * no palette of their own and can be displayed with @a fc_displayFCI
+ * without setting the palette.
+ *
  * @warning only loads the picture, doesn't display it!
  * 
  */
@@ -442,6 +1245,39 @@ fciInfo *fc_loadFCI(char *filename, himemPtr address, himemPtr paletteAddress);
  */
 void fc_displayFCI(fciInfo *info, byte x0, byte y0, bool setPalette);
 
+/**
+ * @brief display part of an FCI image
+ * 
+ * @param info FCI image info block
+ * @param srcX first column of the part (in image characters)
+ * @param srcY first row of the part
+ * @param width width of the part (in image characters)
+ * @param height height of the part
+ * @param dstX x position in current window
+ * @param dstY y position in current window
+ * 
+ * Useful for icon and sprite sheets: many pictures come out of one
+ * image and one load. The part is clipped to the image and to the
+ * current window; ncm characters take two columns each (see
+ * @a fc_addNCMGraphicsRect). Every row is written with one DMA job.
+ * The palette isn't touched.
+ */
+void fc_displayFCIRect(fciInfo *info, byte srcX, byte srcY, byte width, byte height,
+                       byte dstX, byte dstY);
+
+/**
+ * @brief display one frame of an FCI sprite sheet
+ * 
+ * @param info FCI image info block
+ * @param frameWidth frame width (in image characters)
+ * @param frameHeight frame height
+ * @param frame frame number, counting left to right, then top to bottom
+ * @param dstX x position in current window
+ * @param dstY y position in current window
+ */
+void fc_displayFCIFrame(fciInfo *info, byte frameWidth, byte frameHeight, word frame,
+                        byte dstX, byte dstY);
+
 /**
  * @brief fade in FCI image
  * 
@@ -462,6 +1298,279 @@ void fc_fadeFCI(fciInfo *info, byte x0, byte y0, byte steps);
  */
 fciInfo *fc_displayFCIFile(char *filename, byte x0, byte y0);
 
+/**
+ * @brief allocate an empty FCM graphic area to draw into
+ * 
+ * @param columns width (in characters)
+ * @param rows height (in characters)
+ * @return fciInfo* info block of the cleared area, to be shown with
+ *                  @a fc_displayFCI (palette isn't touched)
+ * 
+ * Memory is taken from the graphic area pool and given back by
+ * @a fc_freeGraphAreas. @a columns * @a rows must not exceed 1023.
+ * Together with images loaded by @a fc_loadFCI, at most 16 areas
+ * can be in use.
+ */
+fciInfo *fc_makeGraphArea(byte columns, byte rows);
+
+// ----------------------------------------------------------------------------
+// pixel drawing
+// ----------------------------------------------------------------------------
+
+// These treat a full colour mode graphic area (loaded or made with
+// fc_makeGraphArea) as a surface of columns*8 x rows*8 pixels, one palette
+// index per pixel. Everything is clipped to the surface. NCM images are
+// not supported. Changes show up immediately wherever the area is displayed.
+
+/**
+ * @brief set pixel
+ * 
+ * @param s surface
+ * @param x x coordinate
+ * @param y y coordinate
+ * @param c colour (palette index)
+ */
+void fc_plot(fciInfo *s, word x, word y, byte c);
+
+/**
+ * @brief get pixel
+ * 
+ * @param s surface
+ * @param x x coordinate
+ * @param y y coordinate
+ * @return byte colour (palette index), 0 outside the surface
+ */
+byte fc_pixel(fciInfo *s, word x, word y);
+
+/**
+ * @brief draw horizontal span
+ * 
+ * @param s surface
+ * @param x left x coordinate
+ * @param y y coordinate
+ * @param len length (in pixels)
+ * @param c colour
+ */
+void fc_hspan(fciInfo *s, word x, word y, word len, byte c);
+
+/**
+ * @brief draw vertical span (one DMA fill per character row)
+ * 
+ * @param s surface
+ * @param x x coordinate
+ * @param y top y coordinate
+ * @param len length (in pixels)
+ * @param c colour
+ */
+void fc_vspan(fciInfo *s, word x, word y, word len, byte c);
+
+/**
+ * @brief draw line
+ * 
+ * @param s surface
+ * @param x0 start x
+ * @param y0 start y
+ * @param x1 end x
+ * @param y1 end y
+ * @param c colour
+ */
+void fc_drawLine(fciInfo *s, word x0, word y0, word x1, word y1, byte c);
+
+/**
+ * @brief draw rectangle outline
+ * 
+ * @param s surface
+ * @param x left x coordinate
+ * @param y top y coordinate
+ * @param w width
+ * @param h height
+ * @param c colour
+ */
+void fc_drawRect(fciInfo *s, word x, word y, word w, word h, byte c);
+
+/**
+ * @brief fill rectangle
+ * 
+ * @param s surface
+ * @param x left x coordinate
+ * @param y top y coordinate
+ * @param w width
+ * @param h height
+ * @param c colour
+ * 
+ * Characters covered completely are filled with a single DMA job per
+ * character row.
+ */
+void fc_fillRect(fciInfo *s, word x, word y, word w, word h, byte c);
+
+/**
+ * @brief copy rectangle between (or within) surfaces
+ * 
+ * @param src source surface
+ * @param sx source x
+ * @param sy source y
+ * @param w width
+ * @param h height
+ * @param dst destination surface (may be @a src)
+ * @param dx destination x
+ * @param dy destination y
+ * 
+ * Copies with all coordinates and sizes on character boundaries are
+ * done in one DMA job per character row, everything else row by row
+ * through fcbuf.
+ */
+void fc_copyRect(fciInfo *src, word sx, word sy, word w, word h,
+                 fciInfo *dst, word dx, word dy);
+
+/**
+ * @brief copy image onto surface, skipping transparent pixels
+ * 
+ * @param src source image (FCM)
+ * @param dst destination surface
+ * @param x destination x
+ * @param y destination y
+ * @param transparent colour index not to copy
+ * 
+ * Uses the DMA controller's transparency option. Character aligned
+ * blits take one DMA job per character row, column aligned ones two per
+ * character, everything else one per piece between character edges.
+ */
+void fc_blitTransparent(fciInfo *src, fciInfo *dst, word x, word y, byte transparent);
+
+typedef struct _softSprite
+{
+    fciInfo *image;      ///< sprite image (FCM)
+    fciInfo *surface;    ///< surface to draw onto
+    fciInfo *background; ///< saved background
+    word x;              ///< position, applied by fc_updateSprites
+    word y;
+    word drawnX;         ///< position currently drawn at
+    word drawnY;
+    byte transparent;    ///< transparent colour index
+    bool drawn;          ///< true if currently drawn
+} softSprite;
+
+/**
+ * @brief set up soft sprite
+ * 
+ * @param sp sprite to set up
+ * @param image sprite image
+ * @param surface surface to draw the sprite onto
+ * @param transparent transparent colour index of @a image
+ * 
+ * Allocates a graphic area for the background under the sprite.
+ */
+void fc_initSprite(softSprite *sp, fciInfo *image, fciInfo *surface, byte transparent);
+
+/**
+ * @brief (re)draw soft sprites at their current x/y
+ * 
+ * @param sprites array of sprites
+ * @param count number of sprites
+ * 
+ * First restores the backgrounds of all drawn sprites (last one first),
+ * then saves the new backgrounds and draws the sprites in array order.
+ * Move several sprites by changing their positions and calling this
+ * once, preferably right after the raster has left the surface.
+ */
+void fc_updateSprites(softSprite *sprites, byte count);
+
+/**
+ * @brief remove soft sprites, restoring the background
+ * 
+ * @param sprites array of sprites
+ * @param count number of sprites
+ */
+void fc_hideSprites(softSprite *sprites, byte count);
+
+// ----------------------------------------------------------------------------
+// proportional fonts
+// ----------------------------------------------------------------------------
+
+typedef struct _fcFont
+{
+    byte height;      ///< glyph height in pixels (max. 8)
+    byte firstChar;   ///< ascii code of first glyph
+    byte numChars;    ///< number of glyphs
+    byte levels;      ///< anti-aliasing levels (2-8)
+    byte numKern;     ///< number of kerning pairs
+    byte *widths;     ///< glyph widths
+    word *offsets;    ///< glyph offsets into glyphs
+    byte *glyphs;     ///< glyph pixels (one level per byte)
+    signed char *kern; ///< kerning pairs (left, right, adjustment)
+    byte bg;          ///< background colour
+    byte fg;          ///< text colour
+    byte ramp[8];     ///< palette index for each level
+} fcFont;
+
+/**
+ * @brief load proportional font
+ * 
+ * @param filename fcf file (made with tools/png2fcf.py)
+ * @return fcFont* font, set up for colour 1 on colour 0
+ */
+fcFont *fc_loadFont(char *filename);
+
+/**
+ * @brief free font and drop its cached text runs
+ * 
+ * @param f font
+ */
+void fc_freeFont(fcFont *f);
+
+/**
+ * @brief set font colours
+ * 
+ * @param f font
+ * @param bg background colour
+ * @param fg text colour
+ * 
+ * The anti-aliasing levels in between are mapped to the palette entries
+ * closest to the blended colours, so load the palette first.
+ */
+void fc_fontColours(fcFont *f, byte bg, byte fg);
+
+/**
+ * @brief width of string in pixels, including kerning
+ * 
+ * @param f font
+ * @param s string
+ * @return word width
+ */
+word fc_textWidth(fcFont *f, const char *s);
+
+/**
+ * @brief render string into FCM characters
+ * 
+ * @param f font
+ * @param s string
+ * @param cells receives number of characters rendered
+ * @return himemPtr address of the characters, e.g. for @a fc_addGraphicsRect
+ * 
+ * The last 32 runs are cached: rendering the same string with the same
+ * font and colours again returns the cached characters. Graphic memory
+ * is taken from the graphic area pool, cached runs become invalid with
+ * @a fc_freeGraphAreas.
+ *
+ * Characters of runs shown with @a fc_putText are only reused once they
+ * have disappeared from the screen; those returned here may be reused by
+ * the next call. Returns 0 (and 0 cells) if all cached runs are on screen
+ * or there's no graphic memory left.
+ */
+himemPtr fc_renderText(fcFont *f, const char *s, byte *cells);
+
+/**
+ * @brief render and show string in current window
+ * 
+ * @param f font
+ * @param x x position in current window
+ * @param y y position in current window
+ * @param s string
+ * @return byte number of screen columns used, 0 if the string couldn't be
+ *         rendered (see @a fc_renderText) or more than 48 texts are on screen
+ */
+byte fc_putText(fcFont *f, byte x, byte y, const char *s);
+
 /**
  * @brief plot extended (==full colour) character
  * 
@@ -471,6 +1580,119 @@ fciInfo *fc_displayFCIFile(char *filename, byte x0, byte y0);
  */
 void fc_plotExtChar(byte x, byte y, byte c);
 
+/**
+ * @brief plot any full colour character
+ * 
+ * @param x screen column
+ * @param y screen row
+ * @param charIdx character number (address / 64), e.g. from @a fc_atlasAdd
+ */
+void fc_plotCharIdx(byte x, byte y, word charIdx);
+
+// ----------------------------------------------------------------------------
+// tile maps
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief load tile map into attic RAM
+ * 
+ * @param filename map file: one tile number per byte, row by row
+ * @param width map width in tiles
+ * @param height map height in tiles (@a width * @a height <= 64K)
+ * 
+ * Stops with an error if the file is shorter than the map or longer
+ * than 64K.
+ */
+void fc_tmLoadMap(char *filename, word width, word height);
+
+/**
+ * @brief show tile map on the whole screen
+ * 
+ * @param tiles tile set, loaded with @a fc_loadFCI (tiles are numbered
+ *              row by row)
+ * @param tileWidth tile width in characters
+ * @param tileHeight tile height in characters
+ * 
+ * Takes over the screen: the VIC is pointed at a screen buffer in
+ * graphic memory, so regular text output won't show until
+ * @a fc_tmDone. The map must be at least as large as the screen.
+ */
+void fc_tmInit(fciInfo *tiles, byte tileWidth, byte tileHeight);
+
+/**
+ * @brief stop showing the tile map and go back to the text screen
+ * 
+ */
+void fc_tmDone(void);
+
+/**
+ * @brief jump to map position (redraws the whole screen)
+ * 
+ * @param x left column of the viewport, in characters
+ * @param y top row of the viewport, in characters
+ */
+void fc_tmSetView(word x, word y);
+
+/**
+ * @brief scroll tile map by one character
+ * 
+ * @param dx -1, 0 or 1 (left, none, right)
+ * @param dy -1, 0 or 1 (up, none, down)
+ * 
+ * Only the newly exposed column and/or row is fetched from the map and
+ * written to screen memory. Scrolling stops at the map edges.
+ */
+void fc_tmScroll(signed char dx, signed char dy);
+
+/**
+ * @brief current viewport position (in characters)
+ */
+word fc_tmViewX(void);
+word fc_tmViewY(void);
+
+// ----------------------------------------------------------------------------
+// character atlas
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief add glyph to the character atlas
+ * 
+ * @param glyph 64 bytes of FCM character data (8 rows of 8 pixels)
+ * @return word character number to use with @a fc_plotCharIdx,
+ *              or 0 if the atlas is full
+ * 
+ * If the atlas already contains an identical glyph, its reference count
+ * is increased and its character number is returned instead of taking a
+ * new slot. Call @a fc_atlasRelease once per successful call when the
+ * glyph isn't needed any more.
+ */
+word fc_atlasAdd(const byte *glyph);
+
+/**
+ * @brief take another reference to an atlas character
+ * 
+ * @param charIdx character number returned by @a fc_atlasAdd
+ * @return bool false if @a charIdx isn't an atlas character in use or
+ *              already has 65535 references
+ */
+bool fc_atlasRetain(word charIdx);
+
+/**
+ * @brief drop a reference to an atlas character, freeing the slot
+ * when it was the last one
+ * 
+ * @param charIdx character number returned by @a fc_atlasAdd; other
+ *                numbers are ignored
+ */
+void fc_atlasRelease(word charIdx);
+
+/**
+ * @brief number of free atlas slots
+ * 
+ * @return word free slots
+ */
+word fc_atlasFree(void);
+
 /**
  * @brief plot petscii character
  * 
@@ -482,5 +1704,46 @@ void fc_plotExtChar(byte x, byte y, byte c);
  */
 void fc_plotPetsciiChar(byte x, byte y, byte c, byte color, byte exAttr);
 
+/**
+ * @brief write a span of pre-built cells into the current window
+ * 
+ * @param x x position in current window
+ * @param y y position in current window
+ * @param count number of cells
+ * @param chars address of @a count 16 bit screen words (low byte first)
+ * @param colours address of @a count colour RAM byte pairs (attributes,
+ *                colour) or 0 to leave colours untouched
+ * 
+ * Both source arrays may live in low RAM (pass the pointer cast to himemPtr)
+ * or anywhere in far memory. The span is clipped to the current window and
+ * written with one DMA job per plane.
+ */
+void fc_putCells(byte x, byte y, byte count, himemPtr chars, himemPtr colours);
+
+/**
+ * @brief write a rectangle of pre-built cells into the current window
+ * 
+ * @param x x position in current window
+ * @param y y position in current window
+ * @param width number of cells per row
+ * @param height number of rows
+ * @param chars address of screen words of first row
+ * @param colours address of colour RAM pairs of first row (or 0)
+ * @param stride distance between source rows (in cells)
+ * 
+ * Same as @a fc_putCells for each row, clipped to the current window.
+ */
+void fc_putCellRect(byte x, byte y, byte width, byte height,
+                    himemPtr chars, himemPtr colours, word stride);
+
+#ifdef MATHBENCH
+/**
+ * @brief time fcio's arithmetic on the math unit against cc65's
+ * routines and print the results to the current window
+ * 
+ * Needs fc_init; takes a few seconds. Only built with -DMATHBENCH.
+ */
+void fc_mathBenchmark(void);
+#endif
 
-#endif
\ No newline at end of file
+#endif
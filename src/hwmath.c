@@ -0,0 +1,266 @@
+/*
+ * hwmath.c
+ * multiplications and divisions on the MEGA65 math unit
+ *
+ * Copyright (C) 2019-21 - Stephan Kleinert
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+how it works:
+
+the math unit multiplies MULTINA by MULTINB and divides MULTINA by
+MULTINB all the time. the product is ready right after the inputs are
+written, the quotient when the busy flag clears (a few cycles at most).
+so a multiplication is 4 register writes and as many reads as the
+result needs, instead of a cc65 shift-and-add loop of several hundred
+cycles.
+
+cellOffset keeps gScreenRowBytes in MULTINB, so only the row has to be
+written for each screen address. every other function writes both
+inputs and forgets the cached value.
+
+the raster interrupt saves the inputs with mathSave and writes them
+back with mathRestore, so the results are right again when the
+interrupted program reads them. the cached value is forgotten there
+as well, in case a handler changed gScreenRowBytes.
+
+with FCIO_SOFTMATH defined, cc65's own arithmetic is used instead (for
+other machines and emulators without the math unit).
+
+with MATHBENCH defined, fc_mathBenchmark times both variants.
+*/
+
+#include "fcio.h"
+#include "hwmath.h"
+
+#define MATHBUSY (*(volatile unsigned char *)(0xd70f)) // bit 7: divider busy
+#define MULTINA ((volatile unsigned char *)(0xd770))
+#define MULTOUT ((volatile unsigned char *)(0xd778))
+
+#define MULTINA_W (*(volatile word *)(0xd770))
+#define MULTINA_HI (*(volatile word *)(0xd772))
+#define MULTINB_W (*(volatile word *)(0xd774))
+#define MULTINB_HI (*(volatile word *)(0xd776))
+#define MULTOUT_W (*(volatile word *)(0xd778))
+#define MULTOUT_HI (*(volatile word *)(0xd77a))
+#define DIVOUT_W (*(volatile word *)(0xd76c)) // whole part of the quotient
+
+#ifndef FCIO_SOFTMATH
+
+static word cachedRowBytes; // value in MULTINB (0: unknown)
+static byte savedInputs[8];  // MULTINA and MULTINB of the interrupted program
+
+static void setInputs(word a, word b)
+{
+    cachedRowBytes = 0;
+    MULTINA_W = a;
+    MULTINA_HI = 0;
+    MULTINB_W = b;
+    MULTINB_HI = 0;
+}
+
+unsigned long mathMul(word a, word b)
+{
+    setInputs(a, b);
+    return MULTOUT_W | ((unsigned long)MULTOUT_HI << 16);
+}
+
+word mathDiv(word a, word b)
+{
+    setInputs(a, b);
+    while (MATHBUSY & 0x80)
+        ;
+    return DIVOUT_W;
+}
+
+byte mathScale(byte value, word factor)
+{
+    setInputs(value, factor);
+    return MULTOUT[1];
+}
+
+word cellOffset(byte x, byte y)
+{
+    if (cachedRowBytes != gScreenRowBytes)
+    {
+        MULTINB_W = gScreenRowBytes;
+        MULTINB_HI = 0;
+        MULTINA_HI = 0;
+        cachedRowBytes = gScreenRowBytes;
+    }
+    MULTINA[0] = y;
+    MULTINA[1] = 0;
+    return (x * 2) + MULTOUT_W;
+}
+
+void mathSave(void)
+{
+    static byte i;
+    for (i = 0; i < 8; ++i)
+    {
+        savedInputs[i] = MULTINA[i];
+    }
+}
+
+void mathRestore(void)
+{
+    static byte i;
+    for (i = 0; i < 8; ++i)
+    {
+        MULTINA[i] = savedInputs[i];
+    }
+    cachedRowBytes = 0;
+    // the interrupted program may be past its busy check already
+    while (MATHBUSY & 0x80)
+        ;
+}
+
+#else
+
+unsigned long mathMul(word a, word b)
+{
+    return (unsigned long)a * b;
+}
+
+word mathDiv(word a, word b)
+{
+    return a / b;
+}
+
+byte mathScale(byte value, word factor)
+{
+    return (value * factor) >> 8;
+}
+
+word cellOffset(byte x, byte y)
+{
+    return (x * 2) + (y * gScreenRowBytes);
+}
+
+void mathSave(void)
+{
+}
+
+void mathRestore(void)
+{
+}
+
+#endif
+
+#ifdef MATHBENCH
+
+#define BENCH_RUNS 20000
+#define CYCLES_PER_FRAME 810000l // 40.5 MHz, PAL
+
+static word benchFrames(void)
+{
+    static word f;
+    f = fc_frames();
+    while (fc_frames() == f)
+        ;
+    return fc_frames();
+}
+
+static void benchReport(char *what, word frames, word empty)
+{
+    word cycles;
+    cycles = frames > empty ? ((unsigned long)(frames - empty) * CYCLES_PER_FRAME) / BENCH_RUNS : 0;
+    fc_printf("%-24s %5u frames, ~%u cycles\n", what, frames, cycles);
+}
+
+void fc_mathBenchmark(void)
+{
+    static word i, start, empty;
+    static volatile word sink;
+    static volatile unsigned long sinkLong;
+    static byte b, level, steps;
+
+    fc_printf("math unit benchmark, %u runs each:\n", BENCH_RUNS);
+    level = 100;
+    steps = 128;
+
+    // loop overhead, subtracted from the others
+    start = benchFrames();
+    for (i = 0; i < BENCH_RUNS; ++i)
+    {
+        b = i;
+        sink = b;
+    }
+    empty = fc_frames() - start;
+
+    start = benchFrames();
+    for (i = 0; i < BENCH_RUNS; ++i)
+    {
+        b = i;
+        sink = (b * 2) + (b * gScreenRowBytes);
+    }
+    benchReport("cell offset, cc65", fc_frames() - start, empty);
+
+    start = benchFrames();
+    for (i = 0; i < BENCH_RUNS; ++i)
+    {
+        b = i;
+        sink = cellOffset(b, b);
+    }
+    benchReport("cell offset, cellOffset", fc_frames() - start, empty);
+
+    // fc_fadePalette used to do this for every colour channel
+    start = benchFrames();
+    for (i = 0; i < BENCH_RUNS; ++i)
+    {
+        b = i;
+        sink = (b * level) / steps;
+    }
+    benchReport("fade channel, cc65", fc_frames() - start, empty);
+
+    start = benchFrames();
+    for (i = 0; i < BENCH_RUNS; ++i)
+    {
+        b = i;
+        sink = mathScale(b, 200);
+    }
+    benchReport("fade channel, mathScale", fc_frames() - start, empty);
+
+    start = benchFrames();
+    for (i = 0; i < BENCH_RUNS; ++i)
+    {
+        sinkLong = (unsigned long)i * i;
+    }
+    benchReport("16x16 multiply, cc65", fc_frames() - start, empty);
+
+    start = benchFrames();
+    for (i = 0; i < BENCH_RUNS; ++i)
+    {
+        sinkLong = mathMul(i, i);
+    }
+    benchReport("16x16 multiply, mathMul", fc_frames() - start, empty);
+
+    start = benchFrames();
+    for (i = 0; i < BENCH_RUNS; ++i)
+    {
+        sink = i / steps;
+    }
+    benchReport("16/16 divide, cc65", fc_frames() - start, empty);
+
+    start = benchFrames();
+    for (i = 0; i < BENCH_RUNS; ++i)
+    {
+        sink = mathDiv(i, steps);
+    }
+    benchReport("16/16 divide, mathDiv", fc_frames() - start, empty);
+}
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef __FCIO_HWMATH_H
+#define __FCIO_HWMATH_H
+
+// internal interface to the math unit. the unit's registers are shared
+// like the DMA job list, so interrupt handlers using it must save the
+// inputs first and restore them before returning.
+
+unsigned long mathMul(word a, word b);
+word mathDiv(word a, word b);                 // a / b, b must not be 0
+byte mathScale(byte value, word factor);      // (value * factor) / 256, factor <= 256
+word cellOffset(byte x, byte y);              // offset of screen cell x,y in screen and colour RAM
+void mathSave(void);
+void mathRestore(void);
+
+#endif
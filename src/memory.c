@@ -1,5 +1,6 @@
 #include "memory.h"
 #include <stdio.h>
+#include <string.h>
 
 #define DMALIST (*(struct dmagic_dmalist*)0x500)
 
@@ -7,6 +8,65 @@
 
 unsigned char dma_byte;
 
+// copy job with transparency; needs more options than the shared list
+// has room for, so it gets its own list
+struct dmagic_trans_dmalist {
+    unsigned char option_0b;
+    unsigned char option_80;
+    unsigned char source_mb;
+    unsigned char option_81;
+    unsigned char dest_mb;
+    unsigned char option_86;
+    unsigned char transparent_value;
+    unsigned char option_07; // enable transparency
+    unsigned char end_of_options;
+
+    unsigned char command;
+    unsigned int count;
+    unsigned int source_addr;
+    unsigned char source_bank;
+    unsigned int dest_addr;
+    unsigned char dest_bank;
+    unsigned char sub_cmd;
+    unsigned int modulo;
+};
+
+struct dmagic_trans_dmalist transList= {
+    0x0b, 0x80, 0, 0x81, 0, 0x86, 0, 0x07, 0x00,
+    0x00, 0, 0, 0, 0, 0, 0, 0
+};
+
+// chained rows of lcopy_rect; not saved by save_dmalist()
+#define RECT_CHAIN 32
+static struct dmagic_dmalist rectList[RECT_CHAIN];
+
+// saved job lists of the interrupted program, see save_dmalist()
+struct dmagic_dmalist savedList;
+struct dmagic_trans_dmalist savedTransList;
+
+void save_dmalist(void) {
+    memcpy(&savedList, &DMALIST, sizeof(struct dmagic_dmalist));
+    memcpy(&savedTransList, &transList, sizeof(struct dmagic_trans_dmalist));
+}
+
+void restore_dmalist(void) {
+    memcpy(&DMALIST, &savedList, sizeof(struct dmagic_dmalist));
+    memcpy(&transList, &savedTransList, sizeof(struct dmagic_trans_dmalist));
+}
+
+static void run_dma_list(unsigned int list) {
+    // a raster handler starting its own job between the writes would
+    // leave its list address in $d701, so keep interrupts out (but
+    // don't enable them if the caller runs with them off)
+    __asm__("php");
+    __asm__("sei");
+    POKE(0xd702U, 0);
+    POKE(0xd704U, 0x00); // List is in $00xxxxx
+    POKE(0xd701U, list >> 8);
+    POKE(0xd705U, list & 0xff); // triggers enhanced DMA
+    __asm__("plp");
+}
+
 void do_dma(void) {
     //  unsigned char i;
     mega65_io_enable();
@@ -17,10 +77,7 @@ void do_dma(void) {
     //  while(1) continue;
 
     // Now run DMA job (to and from anywhere, and list is in low 1MB)
-    POKE(0xd702U, 0);
-    POKE(0xd704U, 0x00); // List is in $00xxxxx
-    POKE(0xd701U, ((unsigned int)&DMALIST) >> 8);
-    POKE(0xd705U, ((unsigned int)&DMALIST) & 0xff); // triggers enhanced DMA
+    run_dma_list((unsigned int)&DMALIST);
 }
 
 
@@ -116,6 +173,62 @@ void lcopy(long source_address, long destination_address, unsigned int count) {
     return;
 }
 
+void lcopy_rect(long source_address, long destination_address,
+                unsigned int width, unsigned char height,
+                unsigned int source_stride, unsigned int destination_stride) {
+    static unsigned char i, n;
+    struct dmagic_dmalist *job;
+
+    if (width == 0) {
+        return; // a count of 0 would copy 64K per row
+    }
+
+    // one job per row, chained, so the DMA is started once per RECT_CHAIN rows
+    while (height) {
+        n= height > RECT_CHAIN ? RECT_CHAIN : height;
+        height-= n;
+        for (i= 0, job= rectList; i < n; ++i, ++job) {
+            job->option_0b= 0x0b;
+            job->option_80= 0x80;
+            job->source_mb= source_address >> 20;
+            job->option_81= 0x81;
+            job->dest_mb= destination_address >> 20;
+            job->option_85= 0x85;
+            job->dest_skip= 1;
+            job->end_of_options= 0x00;
+
+            job->command= i == n - 1 ? 0x00 : 0x04; // copy, chain all but the last
+            job->count= width;
+            job->source_addr= source_address & 0xffff;
+            job->source_bank= (source_address >> 16) & 0x0f;
+            job->dest_addr= destination_address & 0xffff;
+            job->dest_bank= (destination_address >> 16) & 0x0f;
+            job->sub_cmd= 0;
+            job->modulo= 0;
+            source_address+= source_stride;
+            destination_address+= destination_stride;
+        }
+        mega65_io_enable();
+        run_dma_list((unsigned int)rectList);
+    }
+    return;
+}
+
+void lcopy_trans(long source_address, long destination_address,
+                 unsigned int count, unsigned char transparent_value) {
+    transList.source_mb= source_address >> 20;
+    transList.dest_mb= destination_address >> 20;
+    transList.transparent_value= transparent_value;
+    transList.count= count;
+    transList.source_addr= source_address & 0xffff;
+    transList.source_bank= (source_address >> 16) & 0x0f;
+    transList.dest_addr= destination_address & 0xffff;
+    transList.dest_bank= (destination_address >> 16) & 0x0f;
+    mega65_io_enable();
+    run_dma_list((unsigned int)&transList);
+    return;
+}
+
 void lfill(long destination_address, unsigned char value, unsigned int count) {
     DMALIST.option_0b= 0x0b;
     DMALIST.option_80= 0x80;
@@ -27,11 +27,23 @@ struct dmagic_dmalist {
 extern unsigned char dma_byte;
 
 void mega65_io_enable(void);
+// interrupt handlers using DMA must save the job lists first and
+// restore them before returning, the main program may be building one
+void save_dmalist(void);
+void restore_dmalist(void);
 void init_dma(void);
 unsigned char lpeek(long address);
 unsigned char lpeek_debounced(long address);
 void lpoke(long address, unsigned char value);
 void lcopy(long source_address, long destination_address, unsigned int count);
+// copies width bytes of each of height rows with one chained DMA job list
+// (per 32 rows). the list isn't saved by save_dmalist(), so don't use it
+// in interrupt handlers.
+void lcopy_rect(long source_address, long destination_address,
+                unsigned int width, unsigned char height,
+                unsigned int source_stride, unsigned int destination_stride);
+void lcopy_trans(long source_address, long destination_address,
+                 unsigned int count, unsigned char transparent_value);
 void lfill(long destination_address, unsigned char value, unsigned int count);
 void lfill_skip(long destination_address, unsigned char value,
                 unsigned int count, unsigned char skip);
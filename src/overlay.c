@@ -0,0 +1,245 @@
+/*
+ * overlay.c
+ * text and character overlays on top of the screen using the raster rewrite buffer
+ *
+ * Copyright (C) 2019-21 - Stephan Kleinert
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+how it works:
+
+the VIC-IV renders each character row into a row buffer, cell by cell.
+a GOTOX cell moves the position where the next cell lands, so cells
+after it are drawn over the ones already in the buffer. with the
+transparent bit set in the GOTOX cell, background pixels of those cells
+leave what's below them alone.
+
+fc_ovlInit widens every screen row: behind the gScreenColumns base
+cells come one GOTOX cell and the overlay cells. CHRCOUNT and LINESTEP
+are set to the new row length, and gScreenRowBytes tells the rest of
+fcio about it. the widened screen lives in graphic memory, the colour
+RAM is widened in place.
+
+empty overlay cells are spaces, which are all background and so
+invisible. drawing into the overlay never touches the base cells, and
+clearing it shows them again at once.
+*/
+
+#include "fcio.h"
+#include "hwmath.h"
+#include "memory.h"
+#include "vic4.h"
+#include <string.h>
+
+extern char asciiToPetscii(byte c);
+
+static bool ovlActive;
+static byte ovlWidth;     // number of overlay cells per row
+static word ovlBaseBytes; // bytes per row before the overlay was set up
+static himemPtr ovlBaseScreen; // screen memory before the overlay was set up
+
+// offset of overlay cell x in row y
+static word ovlOffset(byte x, byte y)
+{
+    return cellOffset(0, y) + ((gScreenColumns + 1 + x) * 2);
+}
+
+static void setRowLength(himemPtr screen, word rowBytes, byte cells)
+{
+    // switch while the beam is in the border to avoid a garbled frame
+    fc_waitVBlank();
+    LINESTEP_LO = rowBytes & 0xff;
+    LINESTEP_HI = rowBytes >> 8;
+    CHRCOUNT = cells;
+    SCNPTR_0 = screen & 0xff;
+    SCNPTR_1 = (screen >> 8) & 0xff;
+    SCNPTR_2 = (screen >> 16) & 0xff;
+}
+
+bool fc_ovlInit(byte x0, byte width)
+{
+    static signed char y;
+    static byte i;
+    himemPtr screen;
+    word rowBytes;
+    word baseBytes;
+    byte *p;
+
+    if (ovlActive || x0 >= gScreenColumns)
+    {
+        return false;
+    }
+    if (width > gScreenColumns - x0)
+    {
+        width = gScreenColumns - x0;
+    }
+
+    baseBytes = gScreenColumns * 2;
+    rowBytes = (gScreenColumns + 1 + width) * 2;
+    // one more row for smooth scrolling
+    screen = fc_allocGraphMem(rowBytes * (gScreenRows + 1));
+    if (screen == 0)
+    {
+        return false;
+    }
+
+    lcopy_rect(gScreenBase, screen, baseBytes, gScreenRows + 1, gScreenRowBytes, rowBytes);
+
+    // widen colour RAM in place, last row first so nothing is overwritten
+    for (y = gScreenRows; y >= 0; --y)
+    {
+        lcopy(gColourBase + (y * gScreenRowBytes), (long)fcbuf, baseBytes);
+        lcopy((long)fcbuf, gColourBase + (y * rowBytes), baseBytes);
+    }
+
+    // overlay part of every row: GOTOX cell, then empty cells
+    p = (byte *)fcbuf;
+    *p++ = (x0 * 8) & 0xff;
+    *p++ = (x0 * 8) >> 8;
+    for (i = 0; i < width; ++i)
+    {
+        *p++ = 32;
+        *p++ = 0;
+    }
+    for (y = 0; y <= gScreenRows; ++y)
+    {
+        lcopy((long)fcbuf, screen + (y * rowBytes) + baseBytes, (width + 1) * 2);
+    }
+    p = (byte *)fcbuf;
+    *p++ = ATTR_GOTOX | ATTR_TRANSPARENT;
+    *p++ = 0;
+    for (i = 0; i < width; ++i)
+    {
+        *p++ = 0;
+        *p++ = 0;
+    }
+    for (y = 0; y <= gScreenRows; ++y)
+    {
+        lcopy((long)fcbuf, gColourBase + (y * rowBytes) + baseBytes, (width + 1) * 2);
+    }
+
+    setRowLength(screen, rowBytes, gScreenColumns + 1 + width);
+    ovlBaseBytes = gScreenRowBytes;
+    ovlBaseScreen = gScreenBase;
+    gScreenBase = screen;
+    gScreenRowBytes = rowBytes;
+    ovlWidth = width;
+    ovlActive = true;
+    return true;
+}
+
+void fc_ovlDone(void)
+{
+    static byte y;
+    word baseBytes;
+
+    if (!ovlActive)
+    {
+        return;
+    }
+    baseBytes = gScreenColumns * 2;
+    lcopy_rect(gScreenBase, ovlBaseScreen, baseBytes, gScreenRows + 1, gScreenRowBytes, ovlBaseBytes);
+    setRowLength(ovlBaseScreen, ovlBaseBytes, gScreenColumns);
+
+    // narrow colour RAM again, first row first
+    for (y = 1; y <= gScreenRows; ++y)
+    {
+        lcopy(gColourBase + (y * gScreenRowBytes), gColourBase + (y * ovlBaseBytes), baseBytes);
+    }
+    gScreenBase = ovlBaseScreen;
+    gScreenRowBytes = ovlBaseBytes;
+    ovlActive = false;
+}
+
+void fc_ovlPutsxy(byte x, byte y, byte colour, const char *s)
+{
+    static byte i, n;
+    word ofs;
+
+    if (!ovlActive || x >= ovlWidth || y >= gScreenRows)
+    {
+        return;
+    }
+    n = strlen(s);
+    if (n > ovlWidth - x)
+    {
+        n = ovlWidth - x;
+    }
+    ofs = ovlOffset(x, y);
+
+    for (i = 0; i < n; ++i)
+    {
+        fcbuf[i * 2] = asciiToPetscii(s[i]);
+        fcbuf[(i * 2) + 1] = 0;
+    }
+    lcopy((long)fcbuf, gScreenBase + ofs, n * 2);
+    lfill_skip(gColourBase + ofs, 0, n, 2);
+    lfill_skip(gColourBase + ofs + 1, colour, n, 2);
+}
+
+void fc_ovlPlotCharIdx(byte x, byte y, word charIdx)
+{
+    word ofs;
+
+    if (!ovlActive || x >= ovlWidth || y >= gScreenRows)
+    {
+        return;
+    }
+    ofs = ovlOffset(x, y);
+    lpoke(gScreenBase + ofs + 1, charIdx / 256);
+    lpoke(gScreenBase + ofs, charIdx % 256);
+    lpoke(gColourBase + ofs, 0);
+    lpoke(gColourBase + ofs + 1, 0);
+}
+
+void fc_ovlClear(byte x, byte y, byte width, byte height)
+{
+    static byte row;
+    word ofs;
+
+    if (!ovlActive || x >= ovlWidth || y >= gScreenRows)
+    {
+        return;
+    }
+    if (width > ovlWidth - x)
+    {
+        width = ovlWidth - x;
+    }
+    if (height > gScreenRows - y)
+    {
+        height = gScreenRows - y;
+    }
+    for (row = y; row < y + height; ++row)
+    {
+        ofs = ovlOffset(x, row);
+        lfill_skip(gScreenBase + ofs, 32, width, 2);
+        lfill_skip(gScreenBase + ofs + 1, 0, width, 2);
+        lfill(gColourBase + ofs, 0, width * 2);
+    }
+}
+
+void fc_ovlSetPos(byte y, word px)
+{
+    word ofs;
+
+    if (!ovlActive || y >= gScreenRows)
+    {
+        return;
+    }
+    ofs = (y * gScreenRowBytes) + (gScreenColumns * 2);
+    lpoke(gScreenBase + ofs, px & 0xff);
+    lpoke(gScreenBase + ofs + 1, (px >> 8) & 0x03);
+}
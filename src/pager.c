@@ -0,0 +1,294 @@
+/*
+ * pager.c
+ * word wrapped viewer for long texts in far memory
+ *
+ * Copyright (C) 2019-21 - Stephan Kleinert
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+how it works:
+
+the document is petscii text anywhere in memory, usually attic RAM.
+lines end with a carriage return ('\n' in cc65), line feeds are
+ignored.
+
+fc_pgWrap scans the document once and writes the offset of every
+wrapped line into a table in attic RAM (PAGERLINES). lines are broken
+after the last space that fits, words longer than the window are cut.
+
+showing a page only reads the table entries of the visible lines plus
+one, then each line's text, converts it to screen cells in fcbuf and
+puts it on screen as one span. so jumping anywhere costs the same,
+however long the document is.
+*/
+
+#include "fcio.h"
+#include "hwmath.h"
+#include "memory.h"
+#include <stdio.h>
+
+#define PG_MAXLINES 0x10000l // PAGERLINES holds 4 bytes per line
+#define PG_MAXROWS 80
+#define PG_TABLECHUNK 32
+#define PG_SCANCHUNK 128
+#define PG_CELLS 0        // fcbuf: screen cells of one line...
+#define PG_TEXT 160       // ...followed by its text
+
+#define CHR_CR 13
+#define CHR_LF 10
+
+extern char asciiToPetscii(byte c);
+
+static himemPtr pgText; // document
+static long pgSize;
+static byte pgWidth;    // width the line table was made for (0: none)
+static word pgLines;
+static word pgTop;      // first line shown
+
+static long pgStarts[PG_MAXROWS + 1];
+static long tableBuf[PG_TABLECHUNK];
+static byte tableFill;
+static word tableNext; // table index of tableBuf[0]
+
+static void flushTable(void)
+{
+    lcopy((long)tableBuf, PAGERLINES + ((long)tableNext * 4), tableFill * 4);
+    tableNext += tableFill;
+    tableFill = 0;
+}
+
+static void addLine(long start)
+{
+    if (pgLines == PG_MAXLINES - 1)
+    {
+        return;
+    }
+    tableBuf[tableFill++] = start;
+    pgLines++;
+    if (tableFill == PG_TABLECHUNK)
+    {
+        flushTable();
+    }
+}
+
+void fc_pgOpen(himemPtr text, long size)
+{
+    pgText = text;
+    pgSize = size;
+    pgWidth = 0;
+    pgLines = 0;
+    pgTop = 0;
+}
+
+void fc_pgLoad(char *filename)
+{
+    static FILE *docFile;
+    static byte n;
+    long count;
+
+    // loadExt counts in 16 bits and has no limit, the line table follows
+    docFile = fopen(filename, "rb");
+    if (!docFile)
+    {
+        fc_fatal("document not found %s", filename);
+    }
+    count = 0;
+    while (1)
+    {
+        n = fread(fcbuf, 1, FCBUFSIZE, docFile);
+        if (n == 0)
+        {
+            break; // a DMA count of 0 would copy 64K
+        }
+        if (count + n > PAGERLINES - PAGERBASE)
+        {
+            fc_fatal("%s exceeds 64K", filename);
+        }
+        lcopy((long)fcbuf, PAGERBASE + count, n);
+        count += n;
+    }
+    fclose(docFile);
+    mega65_io_enable();
+    fc_pgOpen(PAGERBASE, count);
+}
+
+word fc_pgWrap(byte width)
+{
+    static byte i, n, col;
+    static byte c;
+    long pos, lineStart, lastSpace;
+
+    pgLines = 0;
+    tableFill = 0;
+    tableNext = 0;
+    lineStart = 0;
+    lastSpace = 0;
+    col = 0;
+    addLine(0);
+
+    for (pos = 0; pos < pgSize; pos += n)
+    {
+        n = pgSize - pos > PG_SCANCHUNK ? PG_SCANCHUNK : pgSize - pos;
+        lcopy(pgText + pos, (long)fcbuf, n);
+        for (i = 0; i < n; ++i)
+        {
+            c = fcbuf[i];
+            if (c == CHR_CR)
+            {
+                lineStart = pos + i + 1;
+                lastSpace = lineStart;
+                col = 0;
+                addLine(lineStart);
+                continue;
+            }
+            if (c == CHR_LF)
+            {
+                continue;
+            }
+            if (col == width)
+            {
+                if (c == ' ')
+                {
+                    // a space at the wrap point just ends the line
+                    lineStart = pos + i + 1;
+                    lastSpace = lineStart;
+                    col = 0;
+                    addLine(lineStart);
+                    continue;
+                }
+                // wrap after the last space, or cut the word
+                if (lastSpace > lineStart)
+                {
+                    col = (pos + i) - lastSpace;
+                    lineStart = lastSpace;
+                }
+                else
+                {
+                    col = 0;
+                    lineStart = pos + i;
+                }
+                lastSpace = lineStart;
+                addLine(lineStart);
+            }
+            col++;
+            if (c == ' ')
+            {
+                lastSpace = pos + i + 1;
+            }
+        }
+    }
+    // end of the last line
+    tableBuf[tableFill++] = pgSize;
+    flushTable();
+    pgWidth = width;
+    if (pgTop >= pgLines)
+    {
+        pgTop = pgLines - 1;
+    }
+    return pgLines;
+}
+
+// one line as screen cells into fcbuf
+static void lineCells(long start, long end, byte width)
+{
+    static byte i, n, col, c;
+
+    n = end - start > width + 1 ? width + 1 : end - start;
+    lcopy(pgText + start, (long)fcbuf + PG_TEXT, n);
+    col = 0;
+    for (i = 0; i < n && col < width; ++i)
+    {
+        c = fcbuf[PG_TEXT + i];
+        if (c == CHR_CR)
+        {
+            break;
+        }
+        if (c != CHR_LF)
+        {
+            fcbuf[PG_CELLS + (col * 2)] = asciiToPetscii(c);
+            fcbuf[PG_CELLS + (col * 2) + 1] = 0;
+            col++;
+        }
+    }
+    for (; col < width; ++col)
+    {
+        fcbuf[PG_CELLS + (col * 2)] = 32;
+        fcbuf[PG_CELLS + (col * 2) + 1] = 0;
+    }
+}
+
+void fc_pgShow(word line)
+{
+    static byte row, rows, width;
+    word ofs;
+
+    width = gCurrentWin->width;
+    if (width != pgWidth)
+    {
+        fc_pgWrap(width);
+    }
+    if (line >= pgLines)
+    {
+        line = pgLines - 1;
+    }
+    pgTop = line;
+
+    rows = gCurrentWin->height > PG_MAXROWS ? PG_MAXROWS : gCurrentWin->height;
+    if (rows > pgLines - line)
+    {
+        rows = pgLines - line;
+    }
+    // start offsets of the visible lines and of the line after them
+    lcopy(PAGERLINES + ((long)line * 4), (long)pgStarts, (rows + 1) * 4);
+
+    for (row = 0; row < gCurrentWin->height; ++row)
+    {
+        if (row < rows)
+        {
+            lineCells(pgStarts[row], pgStarts[row + 1], width);
+        }
+        else
+        {
+            lineCells(0, 0, width);
+        }
+        fc_putCells(0, row, width, (long)fcbuf + PG_CELLS, 0);
+        ofs = cellOffset(gCurrentWin->x0, gCurrentWin->y0 + row);
+        lfill_skip(gColourBase + ofs, 0, width, 2);
+        lfill_skip(gColourBase + ofs + 1, gCurrentWin->textcolor, width, 2);
+    }
+}
+
+void fc_pgScroll(int lines)
+{
+    long top;
+
+    top = (long)pgTop + lines;
+    if (top < 0)
+    {
+        top = 0;
+    }
+    fc_pgShow(top > 0xffff ? 0xffff : top);
+}
+
+word fc_pgLines(void)
+{
+    return pgLines;
+}
+
+word fc_pgTop(void)
+{
+    return pgTop;
+}
@@ -0,0 +1,294 @@
+/*
+ * pointer.c
+ * text cursor and 1351 mouse pointer as hardware sprites
+ *
+ * Copyright (C) 2019-21 - Stephan Kleinert
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+how it works:
+
+sprite 0 is the text cursor, sprite 1 the mouse pointer. the sprite
+pointer table (16 bit pointers) and both shapes live at SPRITEBASE.
+
+a raster handler in the vertical blank does all the work once per
+frame: it moves the cursor sprite to the cursor position of the current
+window, blinks it, reads the mouse and moves the pointer. printing
+text therefore never has to draw or erase a cursor.
+
+the cursor sprite is a block behind the text, so the character under it
+stays readable. sprite coordinates are in 320x200 units; y is taken
+relative to the text y position, so the sprites follow the screen
+when it's moved by fc_smoothScroll.
+
+the 1351 mouse in proportional mode is read through the SID pot
+registers: bits 1-6 of each pot value count mouse movement modulo 64.
+*/
+
+#include "fcio.h"
+#include "memory.h"
+#include "pointer.h"
+#include "raster.h"
+#include "vic4.h"
+#include <6502.h>
+
+#define CURSOR_SPRITE 0
+#define MOUSE_SPRITE 1
+#define CURSOR_SHAPE (SPRITEBASE + 0x40)
+#define MOUSE_SHAPE (SPRITEBASE + 0x80)
+#define BLINK_FRAMES 16
+
+#define POTX (*(unsigned char *)(0xd419))
+#define POTY (*(unsigned char *)(0xd41a))
+#define CIA1PRA (*(unsigned char *)(0xdc00)) // bits 6/7 select pot port
+#define CIA1PRB (*(unsigned char *)(0xdc01)) // joystick port 1
+
+extern int gTopBorder;
+extern int gBottomBorder;
+
+static const byte mouseShape[] = {
+    0xc0, 0x00, 0x00,
+    0xf0, 0x00, 0x00,
+    0xfc, 0x00, 0x00,
+    0xff, 0x00, 0x00,
+    0xff, 0xc0, 0x00,
+    0xfc, 0x00, 0x00,
+    0xcc, 0x00, 0x00,
+    0x06, 0x00, 0x00,
+    0x06, 0x00, 0x00,
+    0x03, 0x00, 0x00};
+
+static bool installed;
+static volatile bool cursorOn;
+static volatile bool mouseOn;
+static byte blinkCount;
+static byte lastCursorX, lastCursorY;
+static volatile int mouseX, mouseY;
+static volatile byte mouseButtons;
+static byte oldPotX, oldPotY;
+
+static void placeSprite(byte n, int x, int y)
+{
+    SPRX(n) = x & 0xff;
+    if (x & 0x100)
+    {
+        SPRXMSB |= (1 << n);
+    }
+    else
+    {
+        SPRXMSB &= ~(1 << n);
+    }
+    SPRY(n) = y;
+}
+
+// 1351 movement since the last reading, in pixels
+static signed char potDelta(byte value, byte *old)
+{
+    static byte d;
+
+    d = (value - *old) & 0x7f;
+    if (d < 0x40)
+    {
+        d >>= 1;
+        if (d)
+        {
+            *old = value;
+        }
+        return d;
+    }
+    d |= 0xc0;
+    if (d == 0xff)
+    {
+        return 0;
+    }
+    *old = value;
+    return ((signed char)d) >> 1;
+}
+
+static void readMouse(void)
+{
+    static int maxX, maxY;
+    static byte joy;
+
+    maxX = (gScreenColumns * 8) - 1;
+    maxY = (gScreenRows * 8) - 1;
+    mouseX += potDelta(POTX, &oldPotX);
+    mouseY -= potDelta(POTY, &oldPotY);
+    if (mouseX < 0)
+    {
+        mouseX = 0;
+    }
+    else if (mouseX > maxX)
+    {
+        mouseX = maxX;
+    }
+    if (mouseY < 0)
+    {
+        mouseY = 0;
+    }
+    else if (mouseY > maxY)
+    {
+        mouseY = maxY;
+    }
+    joy = ~CIA1PRB; // active low
+    mouseButtons = ((joy & 0x10) >> 4) | ((joy & 0x01) << 1);
+}
+
+static void pointerFrame(void)
+{
+    static int top;
+    static byte cx, cy, xshift, yshift;
+
+    // 320x200 sprite units per screen pixel
+    xshift = (VIC3CTRL & 0x80) ? 1 : 0;
+    yshift = (VIC3CTRL & 0x08) ? 1 : 0;
+    top = 50 + (((TEXTYPOS_LO | ((TEXTYPOS_HI & 0x0f) << 8)) - gTopBorder) / 2);
+
+    if (cursorOn)
+    {
+        cx = gCurrentWin->x0 + gCurrentWin->xc;
+        cy = gCurrentWin->y0 + gCurrentWin->yc;
+        if (cx != lastCursorX || cy != lastCursorY)
+        {
+            // show the cursor at once after it moved
+            lastCursorX = cx;
+            lastCursorY = cy;
+            blinkCount = 0;
+        }
+        placeSprite(CURSOR_SPRITE, 24 + ((cx * 8) >> xshift), top + ((cy * 8) >> yshift));
+        SPRCOL(CURSOR_SPRITE) = gCurrentWin->textcolor;
+        if (blinkCount < BLINK_FRAMES)
+        {
+            SPRENABLE |= (1 << CURSOR_SPRITE);
+        }
+        else
+        {
+            SPRENABLE &= ~(1 << CURSOR_SPRITE);
+        }
+        blinkCount = (blinkCount + 1) & ((BLINK_FRAMES * 2) - 1);
+    }
+
+    if (mouseOn)
+    {
+        readMouse();
+        placeSprite(MOUSE_SPRITE, 24 + (mouseX >> xshift), top + (mouseY >> yshift));
+    }
+}
+
+static void cursorShape(void)
+{
+    static byte y, h;
+    byte mask;
+
+    // one character cell in sprite pixels
+    mask = (VIC3CTRL & 0x80) ? 0xf0 : 0xff;
+    h = (VIC3CTRL & 0x08) ? 4 : 8;
+    lfill(CURSOR_SHAPE, 0, 64);
+    for (y = 0; y < h; ++y)
+    {
+        lpoke(CURSOR_SHAPE + (y * 3), mask);
+    }
+}
+
+static void install(void)
+{
+    static byte n;
+    word ptr;
+
+    if (installed)
+    {
+        return;
+    }
+    mega65_io_enable();
+    lfill(SPRITEBASE, 0, 0xc0);
+    for (n = 0; n < 8; ++n)
+    {
+        ptr = n == MOUSE_SPRITE ? MOUSE_SHAPE / 64 : CURSOR_SHAPE / 64;
+        lpoke(SPRITEBASE + (n * 2), ptr & 0xff);
+        lpoke(SPRITEBASE + (n * 2) + 1, ptr >> 8);
+    }
+    lcopy((long)mouseShape, MOUSE_SHAPE, sizeof(mouseShape));
+
+    SPRPTR_LO = SPRITEBASE & 0xff;
+    SPRPTR_HI = (SPRITEBASE >> 8) & 0xff;
+    SPRPTR_BANK = 0x80 | ((SPRITEBASE >> 16) & 0x7f);
+    SPRMCOL &= ~((1 << CURSOR_SPRITE) | (1 << MOUSE_SPRITE));
+    SPRXEXP &= ~((1 << CURSOR_SPRITE) | (1 << MOUSE_SPRITE));
+    SPRYEXP &= ~((1 << CURSOR_SPRITE) | (1 << MOUSE_SPRITE));
+    SPRPRIO |= (1 << CURSOR_SPRITE);
+    SPRPRIO &= ~(1 << MOUSE_SPRITE);
+
+    fc_addRasterHandler((gBottomBorder / 2) + 2, pointerFrame);
+    installed = true;
+}
+
+void pointerCursor(bool on)
+{
+    install();
+    if (on)
+    {
+        cursorShape();
+        blinkCount = 0;
+        cursorOn = true;
+    }
+    else
+    {
+        cursorOn = false;
+        SPRENABLE &= ~(1 << CURSOR_SPRITE);
+    }
+}
+
+void fc_mouseInit(void)
+{
+    install();
+    CIA1PRA = (CIA1PRA & 0x3f) | 0x40; // pots of port 1
+    oldPotX = POTX;
+    oldPotY = POTY;
+    mouseX = gScreenColumns * 4;
+    mouseY = gScreenRows * 4;
+    SPRCOL(MOUSE_SPRITE) = 1;
+    mouseOn = true;
+    SPRENABLE |= (1 << MOUSE_SPRITE);
+}
+
+void fc_mouseDone(void)
+{
+    mouseOn = false;
+    SPRENABLE &= ~(1 << MOUSE_SPRITE);
+}
+
+int fc_mouseX(void)
+{
+    static int x;
+    SEI();
+    x = mouseX;
+    CLI();
+    return x;
+}
+
+int fc_mouseY(void)
+{
+    static int y;
+    SEI();
+    y = mouseY;
+    CLI();
+    return y;
+}
+
+byte fc_mouseButtons(void)
+{
+    return mouseButtons;
+}
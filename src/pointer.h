@@ -0,0 +1,8 @@
+#ifndef __FCIO_POINTER_H
+#define __FCIO_POINTER_H
+
+// internal interface between fcio and the sprite pointers
+
+void pointerCursor(bool on); // switch the text cursor sprite on or off
+
+#endif
@@ -0,0 +1,283 @@
+/*
+ * raster.c
+ * raster interrupt scheduler: frame counter, deferred jobs, line handlers
+ *
+ * Copyright (C) 2019-21 - Stephan Kleinert
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+how it works:
+
+the raster compare register always holds the line of the next handler
+in the handler table, which is sorted by line. one entry is always the
+vertical blank handler just below the bottom border, which counts
+frames and works off the job queue. after running the handlers of one
+line, the compare register is moved on to the next line; lines the
+beam has already passed are run right away.
+
+the job queue is a ring buffer: the main program only writes jobHead,
+the interrupt only writes jobTail.
+*/
+
+#include "fcio.h"
+#include "hwmath.h"
+#include "memory.h"
+#include "raster.h"
+#include "vic4.h"
+#include <6502.h>
+#include <string.h>
+
+#define MAX_RASTER_HANDLERS 8
+#define JOBQUEUESIZE 32 // must be power of 2
+
+#define JOB_POKE 0
+#define JOB_COPY 1
+#define JOB_FILL 2
+#define JOB_PALETTE 3
+#define JOB_CALL 4
+
+extern unsigned char nyblswap(unsigned char in);
+
+typedef struct _rasterHandler
+{
+    word line;
+    void (*handler)(void);
+} rasterHandler;
+
+typedef struct _rasterJob
+{
+    byte type;
+    byte v0, v1, v2, v3; // poke/fill value or palette entry, red, green, blue
+    word count;
+    long src;
+    long dst;
+    void (*fn)(void);
+} rasterJob;
+
+static rasterHandler handlers[MAX_RASTER_HANDLERS];
+static byte handlerCount;
+static byte nextHandler;
+
+static rasterJob jobs[JOBQUEUESIZE];
+static volatile byte jobHead; // next free slot (only written by main program)
+static volatile byte jobTail; // next job to run (only written by irq)
+
+static volatile word frameCount;
+
+static void runJobs(void)
+{
+    rasterJob *job;
+
+    while (jobTail != jobHead)
+    {
+        job = &jobs[jobTail];
+        switch (job->type)
+        {
+        case JOB_POKE:
+            POKE((word)job->dst, job->v0);
+            break;
+        case JOB_COPY:
+            lcopy(job->src, job->dst, job->count);
+            break;
+        case JOB_FILL:
+            lfill(job->dst, job->v0, job->count);
+            break;
+        case JOB_PALETTE:
+            POKE(0xd100u + job->v0, job->v1);
+            POKE(0xd200u + job->v0, job->v2);
+            POKE(0xd300u + job->v0, job->v3);
+            break;
+        case JOB_CALL:
+            job->fn();
+            break;
+        }
+        jobTail = (jobTail + 1) & (JOBQUEUESIZE - 1);
+    }
+}
+
+static void vblank(void)
+{
+    frameCount++;
+    runJobs();
+}
+
+static word currentLine(void)
+{
+    return RASTER | ((VIC2CTRLA & 0x80) << 1);
+}
+
+static void setCompare(word line)
+{
+    RASTER = line & 0xff;
+    VIC2CTRLA = (VIC2CTRLA & 0x7f) | ((line >> 1) & 0x80);
+}
+
+void rasterInit(word vblankLine)
+{
+    SEI();
+    handlers[0].line = vblankLine;
+    handlers[0].handler = vblank;
+    handlerCount = 1;
+    nextHandler = 0;
+    setCompare(vblankLine);
+    VICIRQ = 0x01;
+    VICIRQMASK |= 0x01;
+    CLI();
+}
+
+void rasterIrq(void)
+{
+    static byte first;
+
+    save_dmalist();
+    mathSave();
+    first = nextHandler;
+    do
+    {
+        handlers[nextHandler].handler();
+        nextHandler++;
+        if (nextHandler == handlerCount)
+        {
+            nextHandler = 0;
+        }
+        // handlers for lines the beam has passed meanwhile run now
+    } while (nextHandler != first && nextHandler != 0 &&
+             handlers[nextHandler].line <= currentLine());
+    setCompare(handlers[nextHandler].line);
+    mathRestore();
+    restore_dmalist();
+}
+
+bool fc_addRasterHandler(word line, void (*handler)(void))
+{
+    static byte i;
+
+    if (handlerCount == MAX_RASTER_HANDLERS)
+    {
+        return false;
+    }
+    SEI();
+    // keep the table sorted by line, after the ones for the same line
+    for (i = handlerCount; i > 0 && handlers[i - 1].line > line; --i)
+    {
+        handlers[i] = handlers[i - 1];
+    }
+    handlers[i].line = line;
+    handlers[i].handler = handler;
+    handlerCount++;
+    nextHandler = 0;
+    setCompare(handlers[0].line);
+    CLI();
+    return true;
+}
+
+void fc_removeRasterHandler(void (*handler)(void))
+{
+    static byte i, j;
+
+    SEI();
+    for (i = 0, j = 0; i < handlerCount; ++i)
+    {
+        if (handlers[i].handler != handler || handlers[i].handler == vblank)
+        {
+            handlers[j++] = handlers[i];
+        }
+    }
+    handlerCount = j;
+    nextHandler = 0;
+    setCompare(handlers[0].line);
+    CLI();
+}
+
+word fc_frames(void)
+{
+    static word f;
+    SEI();
+    f = frameCount;
+    CLI();
+    return f;
+}
+
+void fc_waitFrames(word n)
+{
+    word start;
+    start = fc_frames();
+    while ((word)(fc_frames() - start) < n)
+        ;
+}
+
+void fc_waitVBlank(void)
+{
+    fc_waitFrames(1);
+}
+
+static rasterJob *newJob(byte type)
+{
+    static byte next;
+    next = (jobHead + 1) & (JOBQUEUESIZE - 1);
+    while (next == jobTail)
+        ; // queue full: wait for the next vertical blank
+    jobs[jobHead].type = type;
+    return &jobs[jobHead];
+}
+
+static void queueJob(void)
+{
+    jobHead = (jobHead + 1) & (JOBQUEUESIZE - 1);
+}
+
+void fc_deferPoke(word adr, byte value)
+{
+    rasterJob *job = newJob(JOB_POKE);
+    job->dst = adr;
+    job->v0 = value;
+    queueJob();
+}
+
+void fc_deferCopy(himemPtr src, himemPtr dst, word count)
+{
+    rasterJob *job = newJob(JOB_COPY);
+    job->src = src;
+    job->dst = dst;
+    job->count = count;
+    queueJob();
+}
+
+void fc_deferFill(himemPtr dst, byte value, word count)
+{
+    rasterJob *job = newJob(JOB_FILL);
+    job->dst = dst;
+    job->v0 = value;
+    job->count = count;
+    queueJob();
+}
+
+void fc_deferPalette(byte num, byte red, byte green, byte blue)
+{
+    rasterJob *job = newJob(JOB_PALETTE);
+    job->v0 = num;
+    job->v1 = nyblswap(red);
+    job->v2 = nyblswap(green);
+    job->v3 = nyblswap(blue);
+    queueJob();
+}
+
+void fc_deferCall(void (*fn)(void))
+{
+    rasterJob *job = newJob(JOB_CALL);
+    job->fn = fn;
+    queueJob();
+}
@@ -0,0 +1,9 @@
+#ifndef __FCIO_RASTER_H
+#define __FCIO_RASTER_H
+
+// internal interface between fcio and the raster scheduler
+
+void rasterInit(word vblankLine);
+void rasterIrq(void); // call from irq handler after acknowledging the raster irq
+
+#endif
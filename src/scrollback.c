@@ -0,0 +1,285 @@
+/*
+ * scrollback.c
+ * scrollback buffers for text windows in attic RAM
+ *
+ * Copyright (C) 2019-21 - Stephan Kleinert
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+how it works:
+
+every buffer is a ring of window lines in attic RAM: first the screen
+cells of all lines, then their colour cells. fc_scrollUp hands the top
+line of the window to scrollbackPush before it's scrolled away, which
+costs two small DMA jobs.
+
+for viewing, the lines in the ring followed by the lines in the window
+make up one long text. when the view leaves the bottom, the window
+contents are parked in a save area behind the ring. a view is then
+copied to the screen with one lcopy_rect per source and plane: the ring
+(twice if the view wraps around its end) and the save area. lcopy_rect
+chains one job per line, so that's a single DMA start for views of up
+to 32 lines.
+*/
+
+#include "fcio.h"
+#include "hwmath.h"
+#include "memory.h"
+#include "scrollback.h"
+#include <stddef.h>
+
+#define MAX_SCROLLBACKS 4
+
+typedef struct _scrollback
+{
+    textwin *win;     ///< window (NULL if entry unused)
+    himemPtr adr;     ///< ring: screen cells, then colour cells
+    himemPtr live;    ///< save area for the window contents while viewing
+    word lines;       ///< ring capacity in lines
+    word count;       ///< lines in the ring
+    word next;        ///< slot of the next line to store
+    word back;        ///< lines the view is scrolled back (0: live)
+    byte width;       ///< line width in cells
+} scrollback;
+
+static scrollback buffers[MAX_SCROLLBACKS];
+static himemPtr nextFreeScrollback = SCROLLBACKBASE;
+
+static scrollback *findBuffer(textwin *w)
+{
+    static byte i;
+    for (i = 0; i < MAX_SCROLLBACKS; ++i)
+    {
+        if (buffers[i].win == w)
+        {
+            return &buffers[i];
+        }
+    }
+    return NULL;
+}
+
+static himemPtr winOffset(textwin *w, byte row)
+{
+    return cellOffset(w->x0, w->y0 + row);
+}
+
+// copy n lines starting at ring slot to window row
+static void ringToScreen(scrollback *sb, word slot, byte row, byte n)
+{
+    word lineBytes;
+    himemPtr planeSize;
+
+    lineBytes = sb->width * 2;
+    planeSize = (himemPtr)sb->lines * lineBytes;
+    lcopy_rect(sb->adr + ((himemPtr)slot * lineBytes), gScreenBase + winOffset(sb->win, row),
+               lineBytes, n, lineBytes, gScreenRowBytes);
+    lcopy_rect(sb->adr + planeSize + ((himemPtr)slot * lineBytes), gColourBase + winOffset(sb->win, row),
+               lineBytes, n, lineBytes, gScreenRowBytes);
+}
+
+// copy window rows to or from the save area
+static void liveCopy(scrollback *sb, byte first, byte row, byte n, bool toScreen)
+{
+    word lineBytes;
+    himemPtr planeSize;
+    himemPtr save;
+
+    lineBytes = sb->width * 2;
+    planeSize = (himemPtr)sb->win->height * lineBytes;
+    save = sb->live + ((himemPtr)first * lineBytes);
+    if (toScreen)
+    {
+        lcopy_rect(save, gScreenBase + winOffset(sb->win, row), lineBytes, n, lineBytes, gScreenRowBytes);
+        lcopy_rect(save + planeSize, gColourBase + winOffset(sb->win, row), lineBytes, n, lineBytes, gScreenRowBytes);
+    }
+    else
+    {
+        lcopy_rect(gScreenBase + winOffset(sb->win, row), save, lineBytes, n, gScreenRowBytes, lineBytes);
+        lcopy_rect(gColourBase + winOffset(sb->win, row), save + planeSize, lineBytes, n, gScreenRowBytes, lineBytes);
+    }
+}
+
+static void showView(scrollback *sb)
+{
+    static byte height, fromRing, n;
+    word first, slot;
+
+    height = sb->win->height;
+    // first line of the view, counting from the oldest line in the ring
+    first = sb->count - sb->back;
+    fromRing = sb->back > height ? height : sb->back;
+
+    // the oldest line is count slots before the next free one
+    slot = sb->next >= sb->count ? sb->next - sb->count : sb->next + (sb->lines - sb->count);
+    slot += first;
+    if (slot >= sb->lines)
+    {
+        slot -= sb->lines;
+    }
+    if (fromRing)
+    {
+        n = sb->lines - slot < fromRing ? sb->lines - slot : fromRing;
+        ringToScreen(sb, slot, 0, n);
+        if (n < fromRing)
+        {
+            ringToScreen(sb, 0, n, fromRing - n);
+        }
+    }
+    if (fromRing < height)
+    {
+        liveCopy(sb, 0, fromRing, height - fromRing, true);
+    }
+}
+
+bool fc_sbAttach(textwin *w, word lines)
+{
+    scrollback *sb;
+    himemPtr size;
+
+    if (findBuffer(w))
+    {
+        return true;
+    }
+    sb = findBuffer(NULL);
+    size = ((himemPtr)lines + w->height) * w->width * 4;
+    if (!sb || lines == 0 || nextFreeScrollback + size > SCROLLBACKBASE + SCROLLBACKSIZE)
+    {
+        return false;
+    }
+    sb->win = w;
+    sb->adr = nextFreeScrollback;
+    sb->live = sb->adr + ((himemPtr)lines * w->width * 4);
+    sb->lines = lines;
+    sb->width = w->width;
+    sb->count = 0;
+    sb->next = 0;
+    sb->back = 0;
+    nextFreeScrollback += size;
+    return true;
+}
+
+void fc_sbDetach(textwin *w)
+{
+    static byte i;
+    scrollback *sb;
+
+    sb = findBuffer(w);
+    if (!sb)
+    {
+        return;
+    }
+    fc_sbEnd(w);
+    sb->win = NULL;
+
+    // attic RAM is handed out in order, so it's only reclaimed when all are gone
+    for (i = 0; i < MAX_SCROLLBACKS; ++i)
+    {
+        if (buffers[i].win)
+        {
+            return;
+        }
+    }
+    nextFreeScrollback = SCROLLBACKBASE;
+}
+
+void scrollbackPush(void)
+{
+    scrollback *sb;
+    word lineBytes;
+
+    sb = findBuffer(gCurrentWin);
+    if (!sb)
+    {
+        return;
+    }
+    if (sb->back)
+    {
+        // new output: back to the live window first
+        fc_sbEnd(sb->win);
+    }
+    lineBytes = sb->width * 2;
+    lcopy(gScreenBase + winOffset(sb->win, 0), sb->adr + ((himemPtr)sb->next * lineBytes), lineBytes);
+    lcopy(gColourBase + winOffset(sb->win, 0),
+          sb->adr + ((himemPtr)(sb->lines + sb->next) * lineBytes), lineBytes);
+    sb->next = (sb->next + 1) % sb->lines;
+    if (sb->count < sb->lines)
+    {
+        sb->count++;
+    }
+}
+
+void fc_sbScroll(textwin *w, int lines)
+{
+    scrollback *sb;
+    long back;
+
+    sb = findBuffer(w);
+    if (!sb)
+    {
+        return;
+    }
+    back = (long)sb->back + lines;
+    if (back < 0)
+    {
+        back = 0;
+    }
+    if (back > sb->count)
+    {
+        back = sb->count;
+    }
+    if (back == sb->back)
+    {
+        return;
+    }
+    if (sb->back == 0)
+    {
+        // leaving the live view: park the window contents
+        liveCopy(sb, 0, 0, w->height, false);
+    }
+    sb->back = back;
+    showView(sb);
+}
+
+void fc_sbPageUp(textwin *w)
+{
+    fc_sbScroll(w, w->height);
+}
+
+void fc_sbPageDown(textwin *w)
+{
+    fc_sbScroll(w, -(int)w->height);
+}
+
+void fc_sbEnd(textwin *w)
+{
+    scrollback *sb;
+
+    sb = findBuffer(w);
+    if (!sb || sb->back == 0)
+    {
+        return;
+    }
+    sb->back = 0;
+    liveCopy(sb, 0, 0, w->height, true);
+}
+
+word fc_sbLines(textwin *w)
+{
+    scrollback *sb;
+
+    sb = findBuffer(w);
+    return sb ? sb->count : 0;
+}
@@ -0,0 +1,8 @@
+#ifndef __FCIO_SCROLLBACK_H
+#define __FCIO_SCROLLBACK_H
+
+// internal interface between fcio and the scrollback buffers
+
+void scrollbackPush(void); // call before the current window is scrolled up
+
+#endif
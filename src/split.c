@@ -0,0 +1,274 @@
+/*
+ * split.c
+ * raster split screen: different text modes in horizontal screen regions
+ *
+ * Copyright (C) 2019-21 - Stephan Kleinert
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+how it works:
+
+the screen is cut into up to MAX_REGIONS bands of whole character rows.
+each region has its own H640 setting, CHRCOUNT and LINESTEP and its own
+part of screen and colour memory: the rows of a region are packed right
+behind the ones of the region above, each with the region's line step.
+
+one raster handler in the vertical blank sets up region 0, another one
+just above the first pixel line of every other region switches to that
+region. all register values are computed by fc_splitScreen, so the
+handlers only store bytes and the split doesn't wobble when the main
+program is busy.
+
+the VIC doesn't restart at the screen pointer for every row: it adds
+the line step to an internal row address, and writing the screen or
+colour pointer mid frame only changes the base that address is added
+to. so when a region starts, the line steps of all rows above it have
+already been added, and its pointers are set that far before its data.
+
+fc_selectRegion points gScreenBase, gColourBase and the screen geometry
+at one region, so all fcio output goes there.
+*/
+
+#include "fcio.h"
+#include "memory.h"
+#include "raster.h"
+#include "split.h"
+#include "vic4.h"
+#include <6502.h>
+
+#define MAX_REGIONS 4
+#define SCREENSIZE_MAX 0x2000 // screen memory up to EXTCHARBASE
+
+typedef struct _screenRegion
+{
+    byte startRow;     ///< first screen row
+    byte rows;         ///< number of rows
+    byte columns;      ///< number of columns
+    himemPtr screen;   ///< screen memory of row 0 of this region
+    himemPtr colour;   ///< colour memory of row 0 of this region
+    word rasterLine;   ///< raster line to switch to this region at
+    textwin win;       ///< default window of this region
+    byte vic2, vic3;   ///< precomputed register values
+    byte chrCount;
+    byte lineStepLo, lineStepHi;
+    byte scn0, scn1, scn2;
+    byte colLo, colHi;
+} screenRegion;
+
+extern word gScreenSize;
+extern int gBottomBorder;
+
+static screenRegion regions[MAX_REGIONS];
+static byte regionCount;
+static byte currentRegion;
+static volatile byte nextRegion;
+static byte totalRows;
+static bool baseH640;
+static byte baseV400;
+static byte baseVic2, baseVic3;
+
+static void applyRegion(screenRegion *r)
+{
+    VIC3CTRL = r->vic3;
+    VIC2CTRL = r->vic2;
+    CHRCOUNT = r->chrCount;
+    LINESTEP_LO = r->lineStepLo;
+    LINESTEP_HI = r->lineStepHi;
+    SCNPTR_0 = r->scn0;
+    SCNPTR_1 = r->scn1;
+    SCNPTR_2 = r->scn2;
+    COLPTR_LO = r->colLo;
+    COLPTR_HI = r->colHi;
+}
+
+static void splitTop(void)
+{
+    applyRegion(&regions[0]);
+    nextRegion = 1;
+}
+
+static void splitNext(void)
+{
+    if (nextRegion < regionCount)
+    {
+        applyRegion(&regions[nextRegion]);
+        nextRegion++;
+    }
+}
+
+// compute register values and default window of a region
+static void setupRegion(screenRegion *r, bool h640)
+{
+    screenRegion *above;
+    word lineStep;
+    word added;
+    himemPtr scn;
+    word col;
+
+    // line steps the VIC has added up by the first row of this region
+    added = 0;
+    for (above = regions; above != r; ++above)
+    {
+        added += ((above + 1)->startRow - above->startRow) * above->columns * 2;
+    }
+    lineStep = r->columns * 2;
+    scn = r->screen - added;
+    col = COLOUR_RAM_OFFSET + (word)(r->colour - COLBASE) - added;
+
+    r->vic3 = h640 ? (baseVic3 | 0x80) : baseVic3;
+    r->vic2 = h640 ? (baseVic2 | 0x01) : baseVic2;
+    r->chrCount = r->columns;
+    r->lineStepLo = lineStep & 0xff;
+    r->lineStepHi = lineStep >> 8;
+    r->scn0 = scn & 0xff;
+    r->scn1 = (scn >> 8) & 0xff;
+    r->scn2 = (scn >> 16) & 0xff;
+    r->colLo = col & 0xff;
+    r->colHi = col >> 8;
+
+    r->win.x0 = 0;
+    r->win.y0 = 0;
+    r->win.width = r->columns;
+    r->win.height = r->rows;
+    if (r->win.yc >= r->rows)
+    {
+        r->win.yc = r->rows - 1;
+    }
+}
+
+byte fc_splitScreen(byte row, bool h640)
+{
+    static word textTop;
+    static byte rowLines;
+    screenRegion *last;
+    screenRegion *r;
+    word size;
+
+    mega65_io_enable();
+    if (regionCount == 0)
+    {
+        // region 0 is the screen as set up by fc_screenmode
+        totalRows = gScreenRows;
+        baseH640 = gScreenColumns == 80;
+        baseV400 = VIC3CTRL & 0x08;
+        baseVic3 = VIC3CTRL & 0x7f;
+        baseVic2 = VIC2CTRL & 0xfe;
+        r = &regions[0];
+        r->startRow = 0;
+        r->rows = gScreenRows;
+        r->columns = gScreenColumns;
+        r->screen = SCREENBASE;
+        r->colour = COLBASE;
+        r->win = *gCurrentWin;
+        setupRegion(r, baseH640);
+        regionCount = 1;
+        currentRegion = 0;
+    }
+
+    last = &regions[regionCount - 1];
+    if (regionCount == MAX_REGIONS || row <= last->startRow || row >= totalRows)
+    {
+        return 0;
+    }
+    r = &regions[regionCount];
+    r->startRow = row;
+    r->rows = totalRows - row;
+    r->columns = h640 ? 80 : 40;
+    size = (row - last->startRow) * last->columns * 2;
+    r->screen = last->screen + size;
+    r->colour = last->colour + size;
+    if ((r->screen - SCREENBASE) + (r->rows * r->columns * 2) > SCREENSIZE_MAX)
+    {
+        return 0;
+    }
+
+    // one row of the text area is 8 lines in V200, 4 in V400
+    textTop = (TEXTYPOS_LO | ((TEXTYPOS_HI & 0x0f) << 8)) / 2;
+    rowLines = baseV400 ? 4 : 8;
+    r->rasterLine = textTop + (row * rowLines) - 1;
+
+    r->win.xc = 0;
+    r->win.yc = 0;
+    r->win.textcolor = gCurrentWin->textcolor;
+    r->win.extAttributes = 0;
+    setupRegion(r, h640);
+    lfill_skip(r->screen, 32, r->rows * r->columns, 2);
+    lfill(r->colour, 0, r->rows * r->columns * 2);
+
+    SEI();
+    last->rows = row - last->startRow;
+    setupRegion(last, last->columns == 80);
+    regionCount++;
+    CLI();
+
+    if (regionCount == 2)
+    {
+        fc_addRasterHandler((gBottomBorder / 2) + 2, splitTop);
+    }
+    fc_addRasterHandler(r->rasterLine, splitNext);
+
+    if (currentRegion == regionCount - 2)
+    {
+        // the current region got smaller
+        gScreenRows = last->rows;
+        gScreenSize = gScreenRows * gScreenColumns;
+        if (gCurrentWin->y0 + gCurrentWin->height > gScreenRows)
+        {
+            fc_selectRegion(currentRegion);
+        }
+    }
+    return regionCount - 1;
+}
+
+void fc_selectRegion(byte region)
+{
+    screenRegion *r;
+
+    if (region >= regionCount)
+    {
+        return;
+    }
+    r = &regions[region];
+    currentRegion = region;
+    gScreenBase = r->screen;
+    gColourBase = r->colour;
+    gScreenColumns = r->columns;
+    gScreenRows = r->rows;
+    gScreenSize = r->rows * r->columns;
+    gScreenRowBytes = r->columns * 2;
+    gCurrentWin = &r->win;
+}
+
+void splitStop(void)
+{
+    if (regionCount == 0)
+    {
+        return;
+    }
+    fc_removeRasterHandler(splitNext);
+    fc_removeRasterHandler(splitTop);
+    regionCount = 0;
+    currentRegion = 0;
+}
+
+void fc_unsplitScreen(void)
+{
+    if (regionCount == 0)
+    {
+        return;
+    }
+    fc_screenmode(baseH640, baseV400, totalRows);
+}
@@ -0,0 +1,8 @@
+#ifndef __FCIO_SPLIT_H
+#define __FCIO_SPLIT_H
+
+// internal interface between fcio and the split screen
+
+void splitStop(void); // drop all regions, leaving the VIC registers alone
+
+#endif
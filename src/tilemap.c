@@ -0,0 +1,329 @@
+/*
+ * tilemap.c
+ * large scrolling tile maps streamed from attic RAM
+ *
+ * Copyright (C) 2019-21 - Stephan Kleinert
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+how it works:
+
+the map (one byte per tile, row by row) lives in attic RAM. tiles are
+tileWidth x tileHeight characters of a loaded FCI tile set.
+
+the VIC displays a window of a screen buffer which is TM_SLACK
+characters wider and higher than the screen (LINESTEP is the buffer
+width, SCNPTR and the colour pointer point at the top left visible
+cell). scrolling by one character moves the pointers and streams only
+the newly exposed column or row into the buffer. when the window hits
+the edge of the buffer, the visible part is moved back to the other
+edge (one DMA job per row) - that happens once every TM_SLACK steps.
+
+the colour RAM behind the buffer is cleared once, FCM characters
+don't need anything else there.
+*/
+
+#include "fcio.h"
+#include "memory.h"
+#include "utils.h"
+#include "vic4.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TM_SLACK 16 // extra buffer columns and rows
+#define TM_MAXTILES 256
+#define TM_MAXMAP 0x10000l // room at TILEMAPBASE
+
+static fciInfo *tmTiles;           // tile set
+static byte tmTileWidth;           // tile size in characters
+static byte tmTileHeight;
+static word tmMapWidth;            // map size in tiles
+static word tmMapHeight;
+static word tmTileChar[TM_MAXTILES]; // top left character of each tile
+
+static himemPtr tmBuffer;          // screen buffer
+static word tmColOffset;           // colour buffer (gColourBase) as colour pointer value
+static byte tmBufCols;             // buffer size in characters
+static byte tmBufRows;
+static byte tmOfsX;                // visible window inside buffer
+static byte tmOfsY;
+static word tmViewX;               // viewport position in map characters
+static word tmViewY;
+
+static byte tmTileBuf[128];        // map tiles of the row/column being streamed
+
+static void setPointers(void)
+{
+    himemPtr adr;
+    word ofs;
+
+    ofs = ((tmOfsY * tmBufCols) + tmOfsX) * 2;
+    adr = tmBuffer + ofs;
+    SCNPTR_0 = adr & 0xff;
+    SCNPTR_1 = (adr >> 8) & 0xff;
+    SCNPTR_2 = (adr >> 16) & 0xff;
+    COLPTR_LO = (tmColOffset + ofs) & 0xff;
+    COLPTR_HI = ((tmColOffset + ofs) >> 8) & 0xff;
+}
+
+static himemPtr bufferAdr(byte x, byte y)
+{
+    return tmBuffer + (((y * tmBufCols) + x) * 2);
+}
+
+// stream map column mx (in characters), rows tmViewY.. into buffer column bx
+static void streamColumn(word mx, byte bx)
+{
+    static byte j, cx, cy, n;
+    word ty0, tx, my, ch;
+
+    tx = mx / tmTileWidth;
+    cx = mx % tmTileWidth;
+    ty0 = tmViewY / tmTileHeight;
+    n = ((tmViewY + gScreenRows - 1) / tmTileHeight) - ty0 + 1;
+
+    // one map column: a byte every tmMapWidth bytes
+    lcopy_rect(TILEMAPBASE + ((long)ty0 * tmMapWidth) + tx, (long)tmTileBuf,
+               1, n, tmMapWidth, 1);
+
+    my = tmViewY;
+    for (j = 0; j < gScreenRows; ++j, ++my)
+    {
+        cy = my % tmTileHeight;
+        ch = tmTileChar[tmTileBuf[(my / tmTileHeight) - ty0]] + (cy * tmTiles->columns) + cx;
+        fcbuf[j * 2] = ch & 0xff;
+        fcbuf[(j * 2) + 1] = ch >> 8;
+    }
+    lcopy_rect((long)fcbuf, bufferAdr(bx, tmOfsY), 2, gScreenRows, 2, tmBufCols * 2);
+}
+
+// stream map row my (in characters), columns tmViewX.. into buffer row by
+static void streamRow(word my, byte by)
+{
+    static byte i, cx, cy, n;
+    word tx0, ty, mx, ch;
+
+    ty = my / tmTileHeight;
+    cy = my % tmTileHeight;
+    tx0 = tmViewX / tmTileWidth;
+    n = ((tmViewX + gScreenColumns - 1) / tmTileWidth) - tx0 + 1;
+
+    lcopy(TILEMAPBASE + ((long)ty * tmMapWidth) + tx0, (long)tmTileBuf, n);
+
+    mx = tmViewX;
+    for (i = 0; i < gScreenColumns; ++i, ++mx)
+    {
+        cx = mx % tmTileWidth;
+        ch = tmTileChar[tmTileBuf[(mx / tmTileWidth) - tx0]] + (cy * tmTiles->columns) + cx;
+        fcbuf[i * 2] = ch & 0xff;
+        fcbuf[(i * 2) + 1] = ch >> 8;
+    }
+    lcopy((long)fcbuf, bufferAdr(tmOfsX, by), gScreenColumns * 2);
+}
+
+// move the visible part of the buffer to a new window position
+static void rebase(byte newX, byte newY)
+{
+    static byte j, row;
+    word rowBytes;
+
+    rowBytes = gScreenColumns * 2;
+    for (j = 0; j < gScreenRows; ++j)
+    {
+        // copy in an order that never overwrites rows still to be read
+        row = newY > tmOfsY ? gScreenRows - 1 - j : j;
+        if (newY == tmOfsY && newX > tmOfsX)
+        {
+            // overlapping move to the right inside the same row
+            lcopy(bufferAdr(tmOfsX, tmOfsY + row), (long)fcbuf, rowBytes);
+            lcopy((long)fcbuf, bufferAdr(newX, newY + row), rowBytes);
+        }
+        else
+        {
+            lcopy(bufferAdr(tmOfsX, tmOfsY + row), bufferAdr(newX, newY + row), rowBytes);
+        }
+    }
+    tmOfsX = newX;
+    tmOfsY = newY;
+}
+
+void fc_tmLoadMap(char *filename, word width, word height)
+{
+    static FILE *mapFile;
+    static byte n;
+    long size;
+    long count;
+
+    // loadExt counts in 16 bits, so a full 64K map would read as empty
+    size = (long)width * height;
+    if (size == 0 || size > TM_MAXMAP)
+    {
+        fc_fatal("bad map size %ux%u", width, height);
+    }
+    mapFile = fopen(filename, "rb");
+    if (!mapFile)
+    {
+        fc_fatal("map not found %s", filename);
+    }
+    count = 0;
+    while (1)
+    {
+        n = fread(fcbuf, 1, FCBUFSIZE, mapFile);
+        if (n == 0)
+        {
+            break; // a DMA count of 0 would copy 64K
+        }
+        if (count + n > TM_MAXMAP)
+        {
+            fc_fatal("%s exceeds 64K", filename);
+        }
+        lcopy((long)fcbuf, TILEMAPBASE + count, n);
+        count += n;
+    }
+    fclose(mapFile);
+    mega65_io_enable();
+
+    if (count < size)
+    {
+        fc_fatal("%s is too short", filename);
+    }
+    tmMapWidth = width;
+    tmMapHeight = height;
+}
+
+void fc_tmInit(fciInfo *tiles, byte tileWidth, byte tileHeight)
+{
+    static word t;
+    word tilesPerRow;
+
+    tmTiles = tiles;
+    tmTileWidth = tileWidth;
+    tmTileHeight = tileHeight;
+
+    tilesPerRow = tiles->columns / tileWidth;
+    for (t = 0; t < TM_MAXTILES; ++t)
+    {
+        tmTileChar[t] = (tiles->baseAdr / 64) +
+                        ((t / tilesPerRow) * tileHeight * tiles->columns) +
+                        ((t % tilesPerRow) * tileWidth);
+    }
+
+    tmBufCols = gScreenColumns + TM_SLACK;
+    tmBufRows = gScreenRows + TM_SLACK;
+    tmBuffer = fc_allocGraphMem(tmBufCols * tmBufRows * 2);
+    if (tmBuffer == 0)
+    {
+        fc_fatal("no memory for tile map");
+    }
+    // the colour buffer replaces the colour RAM of the current screen
+    tmColOffset = gColourBase - 0xff80000l;
+    lfill(gColourBase, 0, tmBufCols * tmBufRows * 2);
+
+    mega65_io_enable();
+    LINESTEP_LO = tmBufCols * 2;
+    LINESTEP_HI = 0;
+    SCNPTR_3 &= 0xF0;
+
+    fc_tmSetView(0, 0);
+}
+
+void fc_tmDone(void)
+{
+    mega65_io_enable();
+    LINESTEP_LO = gScreenRowBytes & 0xff;
+    LINESTEP_HI = gScreenRowBytes >> 8;
+    SCNPTR_0 = gScreenBase & 0xff;
+    SCNPTR_1 = (gScreenBase >> 8) & 0xff;
+    SCNPTR_2 = (gScreenBase >> 16) & 0xff;
+    COLPTR_LO = tmColOffset & 0xff;
+    COLPTR_HI = (tmColOffset >> 8) & 0xff;
+    lfill(gColourBase, 0, gScreenRowBytes * gScreenRows);
+    fc_clrscr();
+}
+
+void fc_tmSetView(word x, word y)
+{
+    static byte j;
+
+    if (x > (tmMapWidth * tmTileWidth) - gScreenColumns)
+    {
+        x = (tmMapWidth * tmTileWidth) - gScreenColumns;
+    }
+    if (y > (tmMapHeight * tmTileHeight) - gScreenRows)
+    {
+        y = (tmMapHeight * tmTileHeight) - gScreenRows;
+    }
+    tmViewX = x;
+    tmViewY = y;
+    tmOfsX = TM_SLACK / 2;
+    tmOfsY = TM_SLACK / 2;
+    for (j = 0; j < gScreenRows; ++j)
+    {
+        streamRow(y + j, tmOfsY + j);
+    }
+    setPointers();
+}
+
+void fc_tmScroll(signed char dx, signed char dy)
+{
+    if (dx > 0 && tmViewX + gScreenColumns < tmMapWidth * tmTileWidth)
+    {
+        if (tmOfsX + gScreenColumns == tmBufCols)
+        {
+            rebase(0, tmOfsY);
+        }
+        streamColumn(tmViewX + gScreenColumns, tmOfsX + gScreenColumns);
+        tmOfsX++;
+        tmViewX++;
+    }
+    else if (dx < 0 && tmViewX > 0)
+    {
+        if (tmOfsX == 0)
+        {
+            rebase(tmBufCols - gScreenColumns, tmOfsY);
+        }
+        streamColumn(tmViewX - 1, tmOfsX - 1);
+        tmOfsX--;
+        tmViewX--;
+    }
+
+    if (dy > 0 && tmViewY + gScreenRows < tmMapHeight * tmTileHeight)
+    {
+        if (tmOfsY + gScreenRows == tmBufRows)
+        {
+            rebase(tmOfsX, 0);
+        }
+        streamRow(tmViewY + gScreenRows, tmOfsY + gScreenRows);
+        tmOfsY++;
+        tmViewY++;
+    }
+    else if (dy < 0 && tmViewY > 0)
+    {
+        if (tmOfsY == 0)
+        {
+            rebase(tmOfsX, tmBufRows - gScreenRows);
+        }
+        tmViewY--;
+        tmOfsY--;
+        streamRow(tmViewY, tmOfsY);
+    }
+
+    setPointers();
+}
+
+word fc_tmViewX(void) { return tmViewX; }
+
+word fc_tmViewY(void) { return tmViewY; }
@@ -0,0 +1,53 @@
+#ifndef __MEGA65_VIC4_H
+#define __MEGA65_VIC4_H
+
+// VIC-IV registers shared by the fcio modules
+
+#define VIC_BASE 0xD000UL
+
+#define VIC2CTRL (*(unsigned char *)(0xd016))
+#define VIC4CTRL (*(unsigned char *)(0xd054))
+#define VIC3CTRL (*(unsigned char *)(0xd031))
+#define LINESTEP_LO (*(unsigned char *)(0xd058))
+#define LINESTEP_HI (*(unsigned char *)(0xd059))
+#define CHRCOUNT (*(unsigned char *)(0xd05e))
+#define HOTREG (*(unsigned char *)(0xd05d))
+
+#define SCNPTR_0 (*(unsigned char *)(0xd060))
+#define SCNPTR_1 (*(unsigned char *)(0xd061))
+#define SCNPTR_2 (*(unsigned char *)(0xd062))
+#define SCNPTR_3 (*(unsigned char *)(0xd063))
+
+#define VIC2CTRLA (*(unsigned char *)(0xd011)) // bit 7: raster compare bit 8
+#define RASTER (*(unsigned char *)(0xd012))
+#define VICIRQ (*(unsigned char *)(0xd019))
+#define VICIRQMASK (*(unsigned char *)(0xd01a))
+
+#define TEXTYPOS_LO (*(unsigned char *)(0xd04e))
+#define TEXTYPOS_HI (*(unsigned char *)(0xd04f))
+#define DISPROWS (*(unsigned char *)(0xd07b))
+
+#define COLPTR_LO (*(unsigned char *)(0xd064))
+#define COLPTR_HI (*(unsigned char *)(0xd065))
+
+#define SPRX(n) (*(unsigned char *)(0xd000 + ((n) * 2)))
+#define SPRY(n) (*(unsigned char *)(0xd001 + ((n) * 2)))
+#define SPRXMSB (*(unsigned char *)(0xd010))
+#define SPRENABLE (*(unsigned char *)(0xd015))
+#define SPRYEXP (*(unsigned char *)(0xd017))
+#define SPRPRIO (*(unsigned char *)(0xd01b)) // set: sprite behind foreground
+#define SPRMCOL (*(unsigned char *)(0xd01c))
+#define SPRXEXP (*(unsigned char *)(0xd01d))
+#define SPRCOL(n) (*(unsigned char *)(0xd027 + (n)))
+#define SPRPTR_LO (*(unsigned char *)(0xd06c)) // sprite pointer table address
+#define SPRPTR_HI (*(unsigned char *)(0xd06d))
+#define SPRPTR_BANK (*(unsigned char *)(0xd06e)) // bit 7: 16 bit sprite pointers
+
+#define COLOUR_RAM_OFFSET (COLBASE - 0xff80000l)
+
+// first colour RAM byte attributes
+#define ATTR_NCM 0x08         // nibble colour mode character
+#define ATTR_GOTOX 0x10       // screen word is a GOTOX position
+#define ATTR_TRANSPARENT 0x80 // GOTOX: background pixels of the following cells are transparent
+
+#endif
@@ -0,0 +1,351 @@
+/*
+ * winmgr.c
+ * simple overlapping window manager for fcio
+ *
+ * Copyright (C) 2019-21 - Stephan Kleinert
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+how it works:
+
+every managed window owns a backing store in attic RAM holding its
+screen and colour cells. only the topmost window is drawn into, so it
+is always completely visible and its backing store is brought up to
+date (syncTop) right before the z-order or geometry changes. all other
+backing stores are current anyway, because nothing draws into them.
+
+when windows are raised, moved or closed, only the rectangles which
+become visible are repainted from the backing stores of the windows
+(and the desktop) covering them, one DMA job per row and plane.
+*/
+
+#include "fcio.h"
+#include "hwmath.h"
+#include "memory.h"
+#include <stddef.h>
+
+#define MAX_WINDOWS 12
+#define DESKTOP MAX_WINDOWS // backing store slot of the desktop
+
+typedef struct _rect
+{
+    byte x0, y0; // top left
+    byte x1, y1; // bottom right (exclusive)
+} rect;
+
+textwin wmWins[MAX_WINDOWS];         // window structures, by slot
+byte wmSlot[MAX_WINDOWS];            // slot numbers in z-order (0 == bottom)
+bool wmSlotUsed[MAX_WINDOWS];        // slot allocation
+byte winCount;                       // number of open windows
+textwin wmDesktop;                   // pseudo window for the desktop
+
+static himemPtr storeAdr(byte slot)
+{
+    return WMSTOREBASE + (slot * WMSTORESIZE);
+}
+
+static void winRect(textwin *w, rect *r)
+{
+    r->x0 = w->x0;
+    r->y0 = w->y0;
+    r->x1 = w->x0 + w->width;
+    r->y1 = w->y0 + w->height;
+}
+
+static bool intersect(rect *a, rect *b, rect *out)
+{
+    out->x0 = a->x0 > b->x0 ? a->x0 : b->x0;
+    out->y0 = a->y0 > b->y0 ? a->y0 : b->y0;
+    out->x1 = a->x1 < b->x1 ? a->x1 : b->x1;
+    out->y1 = a->y1 < b->y1 ? a->y1 : b->y1;
+    return out->x0 < out->x1 && out->y0 < out->y1;
+}
+
+static void copyRect(textwin *w, byte slot, rect *r, bool toScreen)
+{
+    himemPtr store;
+    himemPtr screenOffset;
+    word storeOffset;
+    word planeSize;
+    word rowBytes;
+    byte height;
+
+    store = storeAdr(slot);
+    planeSize = w->width * w->height * 2;
+    storeOffset = (((r->y0 - w->y0) * w->width) + (r->x0 - w->x0)) * 2;
+    screenOffset = cellOffset(r->x0, r->y0);
+    rowBytes = (r->x1 - r->x0) * 2;
+    height = r->y1 - r->y0;
+
+    if (toScreen)
+    {
+        lcopy_rect(store + storeOffset, gScreenBase + screenOffset, rowBytes, height,
+                   w->width * 2, gScreenRowBytes);
+        lcopy_rect(store + planeSize + storeOffset, gColourBase + screenOffset, rowBytes, height,
+                   w->width * 2, gScreenRowBytes);
+    }
+    else
+    {
+        lcopy_rect(gScreenBase + screenOffset, store + storeOffset, rowBytes, height,
+                   gScreenRowBytes, w->width * 2);
+        lcopy_rect(gColourBase + screenOffset, store + planeSize + storeOffset, rowBytes, height,
+                   gScreenRowBytes, w->width * 2);
+    }
+}
+
+static void saveWindow(textwin *w, byte slot)
+{
+    rect r;
+    winRect(w, &r);
+    copyRect(w, slot, &r, false);
+}
+
+static void syncTop(void)
+{
+    if (winCount)
+    {
+        saveWindow(&wmWins[wmSlot[winCount - 1]], wmSlot[winCount - 1]);
+    }
+}
+
+/*
+repaint a screen rectangle from the windows with z-order below 'limit'.
+painting starts at the topmost window which covers the rectangle
+completely, everything beneath that one would be overdrawn anyway.
+*/
+static void repaint(rect *damage, byte limit)
+{
+    static signed char z;
+    static byte start;
+    rect r, part;
+    textwin *w;
+
+    start = 0;
+    for (z = limit - 1; z >= 0; --z)
+    {
+        winRect(&wmWins[wmSlot[z]], &r);
+        if (r.x0 <= damage->x0 && r.y0 <= damage->y0 &&
+            r.x1 >= damage->x1 && r.y1 >= damage->y1)
+        {
+            start = z + 1;
+            break;
+        }
+    }
+
+    if (start == 0)
+    {
+        copyRect(&wmDesktop, DESKTOP, damage, true);
+    }
+    else
+    {
+        start--;
+    }
+
+    for (z = start; z < limit; ++z)
+    {
+        w = &wmWins[wmSlot[z]];
+        winRect(w, &r);
+        if (intersect(damage, &r, &part))
+        {
+            copyRect(w, wmSlot[z], &part, true);
+        }
+    }
+}
+
+static signed char zOrderOf(textwin *w)
+{
+    static signed char z;
+    for (z = 0; z < winCount; ++z)
+    {
+        if (&wmWins[wmSlot[z]] == w)
+        {
+            return z;
+        }
+    }
+    return -1;
+}
+
+void fc_wmInit(void)
+{
+    static byte i;
+
+    winCount = 0;
+    for (i = 0; i < MAX_WINDOWS; ++i)
+    {
+        wmSlotUsed[i] = false;
+    }
+    wmDesktop.x0 = 0;
+    wmDesktop.y0 = 0;
+    wmDesktop.width = gScreenColumns;
+    wmDesktop.height = gScreenRows;
+    saveWindow(&wmDesktop, DESKTOP);
+}
+
+textwin *fc_wmOpen(byte x0, byte y0, byte width, byte height)
+{
+    static byte slot;
+    textwin *w;
+
+    for (slot = 0; slot < MAX_WINDOWS; ++slot)
+    {
+        if (!wmSlotUsed[slot])
+        {
+            break;
+        }
+    }
+    if (slot == MAX_WINDOWS)
+    {
+        fc_fatal("too many windows");
+    }
+
+    syncTop();
+    wmSlotUsed[slot] = true;
+    wmSlot[winCount++] = slot;
+
+    w = &wmWins[slot];
+    w->x0 = x0;
+    w->y0 = y0;
+    w->width = width;
+    w->height = height;
+    w->xc = 0;
+    w->yc = 0;
+    w->extAttributes = 0;
+    w->textcolor = gCurrentWin->textcolor;
+    fc_setwin(w);
+    fc_clrscr();
+    return w;
+}
+
+void fc_wmClose(textwin *w)
+{
+    static signed char z;
+    rect r;
+
+    z = zOrderOf(w);
+    if (z < 0)
+    {
+        return;
+    }
+    syncTop();
+
+    wmSlotUsed[wmSlot[z]] = false;
+    for (; z < winCount - 1; ++z)
+    {
+        wmSlot[z] = wmSlot[z + 1];
+    }
+    winCount--;
+
+    winRect(w, &r);
+    repaint(&r, winCount);
+
+    if (winCount)
+    {
+        fc_setwin(&wmWins[wmSlot[winCount - 1]]);
+    }
+    else
+    {
+        fc_resetwin();
+    }
+}
+
+void fc_wmRaise(textwin *w)
+{
+    static signed char z;
+    static byte slot, i;
+    rect r, above, part;
+
+    z = zOrderOf(w);
+    if (z < 0)
+    {
+        return;
+    }
+    fc_setwin(w);
+    if (z == winCount - 1)
+    {
+        return;
+    }
+    syncTop();
+
+    // the parts of w covered by windows above it become visible
+    winRect(w, &r);
+    slot = wmSlot[z];
+    for (i = z + 1; i < winCount; ++i)
+    {
+        winRect(&wmWins[wmSlot[i]], &above);
+        if (intersect(&r, &above, &part))
+        {
+            copyRect(w, slot, &part, true);
+        }
+        wmSlot[i - 1] = wmSlot[i];
+    }
+    wmSlot[winCount - 1] = slot;
+}
+
+void fc_wmMove(textwin *w, byte x0, byte y0)
+{
+    rect oldR, newR, part, exposed;
+    static byte slot;
+
+    if (zOrderOf(w) < 0)
+    {
+        return;
+    }
+    fc_wmRaise(w);
+    syncTop();
+    slot = wmSlot[winCount - 1];
+
+    winRect(w, &oldR);
+    w->x0 = x0;
+    w->y0 = y0;
+    winRect(w, &newR);
+
+    // repaint the parts of the old area not covered by the new one
+    if (!intersect(&oldR, &newR, &part))
+    {
+        repaint(&oldR, winCount - 1);
+    }
+    else
+    {
+        exposed = oldR;
+        if (newR.y0 > oldR.y0)
+        {
+            exposed.y1 = newR.y0;
+            repaint(&exposed, winCount - 1);
+        }
+        if (newR.y1 < oldR.y1)
+        {
+            exposed.y0 = newR.y1;
+            exposed.y1 = oldR.y1;
+            repaint(&exposed, winCount - 1);
+        }
+        exposed.y0 = part.y0;
+        exposed.y1 = part.y1;
+        if (newR.x0 > oldR.x0)
+        {
+            exposed.x0 = oldR.x0;
+            exposed.x1 = newR.x0;
+            repaint(&exposed, winCount - 1);
+        }
+        if (newR.x1 < oldR.x1)
+        {
+            exposed.x0 = newR.x1;
+            exposed.x1 = oldR.x1;
+            repaint(&exposed, winCount - 1);
+        }
+    }
+
+    copyRect(w, slot, &newR, true);
+}
@@ -1,14 +1,13 @@
 #!/bin/sh
 
 set -e
-rm -rf gamedata/*
+mkdir -p gamedata
+
+# png2fci's batch mode converts in parallel and skips images
+# that haven't changed since the last run (see gamedata/.png2fci-cache)
 
 # convert ui images with palette
-for filename in images-src/ui/*.png; do
-  python3 tools/png2fci.py -v $filename gamedata/$(basename $filename .png).fci
-done
+python3 tools/png2fci.py -vb gamedata images-src/ui/*.png
 
 # convert aux images and shift palette
-for filename in images-src/artwork/*.png; do
-  python3 tools/png2fci.py -vr $filename gamedata/$(basename $filename .png).fci
-done
\ No newline at end of file
+python3 tools/png2fci.py -vrb gamedata images-src/artwork/*.png
@@ -0,0 +1,197 @@
+#!/usr/bin/env python
+
+#######################################################################
+# png2fcf version 1.0                                                 #
+# converts proportional fonts for fcio                                #
+#######################################################################
+
+import sys
+import png
+
+gVerbose = False
+gInvert = False
+gFirstChar = 32
+gLevels = 4
+gKernFileName = None
+gVersion = "1.0"
+
+
+class ConversionError(Exception):
+    def __init__(self, message, code):
+        Exception.__init__(self, message)
+        self.code = code
+
+
+def vprint(*values):
+    global gVerbose
+    if gVerbose == True:
+        print(*values)
+
+
+def showUsage():
+    print("usage: "+sys.argv[0]+" [-vi] [-fN] [-lN] [-k kernfile] infile outfile")
+    print("convert PNG font strip to MEGA65 fcf file")
+    print("")
+    print("the top pixel row of infile is the marker row: every bright pixel")
+    print("there starts a new glyph, which extends up to the next marker.")
+    print("the rows below (max. 8) hold the glyphs, one after another,")
+    print("starting with the character given by -f.")
+    print("")
+    print("options: -v  verbose output")
+    print("         -i  invert (dark glyphs on bright background)")
+    print("         -fN code of first glyph (default: 32)")
+    print("         -lN number of anti-aliasing levels, 2-8 (default: 4)")
+    print("         -k  kerning file: one pair per line, e.g. 'AV -1'")
+    exit(0)
+
+
+def parseArgs():
+    global gVerbose, gInvert, gFirstChar, gLevels, gKernFileName
+    args = sys.argv.copy()
+    args.remove(args[0])
+    fileargs = []
+    expectKernFile = False
+
+    for arg in args:
+        if expectKernFile:
+            gKernFileName = arg
+            expectKernFile = False
+        elif arg[0:1] == "-":
+            opts = arg[1:]
+            for idx, opt in enumerate(opts):
+                if opt == "v":
+                    gVerbose = True
+                elif opt == "i":
+                    gInvert = True
+                elif opt == "k":
+                    expectKernFile = True
+                elif opt == "f" or opt == "l":
+                    try:
+                        value = int(opts[idx+1:])
+                    except ValueError:
+                        print("-"+opt+" needs a number")
+                        showUsage()
+                    if opt == "f":
+                        gFirstChar = value
+                    else:
+                        gLevels = value
+                    break
+                else:
+                    print("Unknown option", opt)
+                    showUsage()
+        else:
+            fileargs.append(arg)
+
+    if len(fileargs) != 2:
+        print("need exactly one infile and one outfile")
+        showUsage()
+    if gLevels < 2 or gLevels > 8:
+        print("number of levels must be between 2 and 8")
+        showUsage()
+    return fileargs
+
+
+def readPNG(inputFileName):
+    vprint("reading", inputFileName)
+    width, height, rows, info = png.Reader(filename=inputFileName).asRGBA8()
+    vprint("infile size is ", width, "x", height, "pixels")
+
+    if height < 2 or height > 9:
+        raise ConversionError("error: need a marker row and 1-8 glyph rows,\n"
+                              "but infile is "+str(height)+" pixels high", 5)
+
+    # reduce to intensities (0-255), ink is bright
+    intensities = []
+    for row in rows:
+        row = bytes(row)
+        line = []
+        for x in range(0, width*4, 4):
+            lum = (row[x]*299 + row[x+1]*587 + row[x+2]*114)//1000
+            if gInvert:
+                lum = 255-lum
+            line.append(lum*row[x+3]//255)
+        intensities.append(line)
+    return width, height, intensities
+
+
+def splitGlyphs(width, intensities):
+    markers = [x for x in range(width) if intensities[0][x] >= 128]
+    if not markers:
+        raise ConversionError("error: no glyph markers found in top row", 6)
+    ends = markers[1:]+[width]
+    glyphs = []
+    for start, end in zip(markers, ends):
+        glyph = []
+        for line in intensities[1:]:
+            glyph.append([(lum*(gLevels-1)+127)//255 for lum in line[start:end]])
+        glyphs.append((end-start, glyph))
+    return glyphs
+
+
+def readKerning(kernFileName):
+    pairs = []
+    with open(kernFileName, "r") as kernFile:
+        for lineNo, line in enumerate(kernFile, 1):
+            line = line.rstrip("\n")
+            if line.strip() == "" or line.startswith("#"):
+                continue
+            try:
+                adjust = int(line[2:])
+            except ValueError:
+                raise ConversionError("error: bad kerning pair in line " +
+                                      str(lineNo)+": "+line, 7)
+            if adjust < -128 or adjust > 127:
+                raise ConversionError("error: kerning out of range in line " +
+                                      str(lineNo), 7)
+            pairs.append((ord(line[0]), ord(line[1]), adjust))
+    if len(pairs) > 255:
+        raise ConversionError("error: too many kerning pairs (max. 255)", 7)
+    return pairs
+
+
+def writeFCF(out, height, glyphs, kerning):
+    out.write(bytes([0x46, 0x43, 0x46]))  # 'FCF'
+    out.write(bytes([1, height, gFirstChar, len(glyphs), gLevels, len(kerning)]))
+    out.write(bytes([w for w, g in glyphs]))
+    for width, glyph in glyphs:
+        for line in glyph:
+            out.write(bytes(line))
+    for left, right, adjust in kerning:
+        out.write(bytes([left, right, adjust & 0xff]))
+
+
+def convertFile(inputFileName, outputFileName):
+    width, height, intensities = readPNG(inputFileName)
+    glyphs = splitGlyphs(width, intensities)
+    if len(glyphs) > 255:
+        # the glyph count is stored in one byte
+        raise ConversionError("error: "+str(len(glyphs))+" glyphs, but a font "
+                              "can hold at most 255", 6)
+    if gFirstChar+len(glyphs) > 256:
+        raise ConversionError("error: too many glyphs for first char " +
+                              str(gFirstChar), 6)
+    for width, glyph in glyphs:
+        if width > 255:
+            raise ConversionError("error: glyph wider than 255 pixels", 6)
+    vprint("found", len(glyphs), "glyphs,", height-1, "pixels high")
+
+    kerning = []
+    if gKernFileName:
+        kerning = readKerning(gKernFileName)
+        vprint("read", len(kerning), "kerning pairs")
+
+    with open(outputFileName, "wb") as outfile:
+        writeFCF(outfile, height-1, glyphs, kerning)
+
+
+if __name__ == "__main__":
+    fileArgs = parseArgs()
+
+    vprint("### png2fcf v"+gVersion+" ###")
+
+    try:
+        convertFile(fileArgs[0], fileArgs[1])
+    except (ConversionError, OSError) as e:
+        print(e)
+        exit(getattr(e, "code", 1))
+    vprint("done.")
@@ -10,12 +10,33 @@ import sys
 from zlib import compress
 import png
 import io
+import os
+import json
+import hashlib
+import multiprocessing
+import re
+import struct
 
 gVerbose = False
 gReserve = False
 gCompress = False
 gExcludePalette = False
-gVersion = "1.0"
+gBatch = False
+gSharedPalette = False
+gNCM = False
+gJobs = 0
+gAnimation = False
+gIndexSwaps = False
+gFrameDelay = 2
+gVersion = "1.1"
+
+gCacheFileName = ".png2fci-cache"
+
+
+class ConversionError(Exception):
+    def __init__(self, message, code):
+        Exception.__init__(self, message)
+        self.code = code
 
 
 def vprint(*values):
@@ -25,12 +46,28 @@ def vprint(*values):
 
 
 def showUsage():
-    print("usage: "+sys.argv[0]+" [-rv] infile outfile")
+    print("usage: "+sys.argv[0]+" [-rvcx] infile outfile")
+    print("       "+sys.argv[0]+" -b [-rvcx] [-jN] outdir infile...")
+    print("       "+sys.argv[0]+" -s [-rvc] [-jN] outdir palfile infile...")
+    print("       "+sys.argv[0]+" -a [-rvni] [-dN] outfile infile...")
     print("convert PNG to MEGA65 fci file")
     print("options: -r  reserve system palette entries")
     print("         -x  exclude palette data")
     print("         -v  verbose output")
     print("         -c  compress output")
+    print("         -n  nibble colour mode (max. 16 colours, 16x8 pixels per character)")
+    print("         -b  batch mode: convert all infiles into outdir,")
+    print("             skipping files that haven't changed since last run")
+    print("         -s  shared palette: like -b, but merge the colours of all")
+    print("             infiles into palfile and write the images without")
+    print("             palette data, remapped to the shared palette")
+    print("             (reduced with median cut if the colours don't fit)")
+    print("         -jN use N worker processes in batch mode (default: all cores)")
+    print("         -a  animation: write the numbered infiles as one fca file,")
+    print("             a keyframe followed by the changed characters of each frame")
+    print("         -i  animation: reuse characters already in memory by changing")
+    print("             screen indices instead of sending them again")
+    print("         -dN animation: show each frame for N vertical blanks (default: 2)")
     exit(0)
 
 
@@ -42,15 +79,16 @@ def nybswap(i):
 
 
 def parseArgs():
-    global gReserve, gVerbose, gCompress, gExcludePalette
+    global gReserve, gVerbose, gCompress, gExcludePalette, gBatch, gJobs
+    global gSharedPalette, gNCM, gAnimation, gIndexSwaps, gFrameDelay
     args = sys.argv.copy()
     args.remove(args[0])
-    fileargcount = 0
+    fileargs = []
 
     for arg in args:
         if arg[0:1] == "-":
             opts = arg[1:]
-            for opt in opts:
+            for idx, opt in enumerate(opts):
                 if opt == "r":
                     gReserve = True
                 elif opt == "v":
@@ -59,58 +97,139 @@ def parseArgs():
                     gCompress = True
                 elif opt == "x":
                     gExcludePalette = True
-
+                elif opt == "n":
+                    gNCM = True
+                elif opt == "b":
+                    gBatch = True
+                elif opt == "s":
+                    gBatch = True
+                    gSharedPalette = True
+                    gExcludePalette = True
+                elif opt == "j":
+                    try:
+                        gJobs = int(opts[idx+1:])
+                    except ValueError:
+                        print("-j needs a number")
+                        showUsage()
+                    break
+                elif opt == "a":
+                    gAnimation = True
+                elif opt == "i":
+                    gIndexSwaps = True
+                elif opt == "d":
+                    try:
+                        gFrameDelay = int(opts[idx+1:])
+                    except ValueError:
+                        print("-d needs a number")
+                        showUsage()
+                    if gFrameDelay < 1 or gFrameDelay > 255:
+                        print("-d needs a number from 1 to 255")
+                        showUsage()
+                    break
                 else:
                     print("Unknown option", opt)
                     showUsage()
         else:
-            fileargcount += 1
-            if fileargcount == 1:
-                infile = arg
-            elif fileargcount == 2:
-                outfile = arg
-            else:
-                print("too many arguments")
-                showUsage()
-    return infile, outfile
-
-
-def pngRowsToM65Rows(pngRows):
-    pngX = 0
-    pngY = 0
+            fileargs.append(arg)
+
+    if gAnimation:
+        if gBatch:
+            print("-a can't be combined with -b or -s")
+            showUsage()
+        if len(fileargs) < 2:
+            print("animation mode needs an outfile and at least one infile")
+            showUsage()
+    elif gSharedPalette:
+        if len(fileargs) < 3:
+            print("shared palette mode needs an output directory, "
+                  "a palette file and at least one infile")
+            showUsage()
+    elif gBatch:
+        if len(fileargs) < 2:
+            print("batch mode needs an output directory and at least one infile")
+            showUsage()
+    elif len(fileargs) != 2:
+        print("need exactly one infile and one outfile")
+        showUsage()
+    return fileargs
+
+
+def setOptions(options):
+    global gReserve, gVerbose, gCompress, gExcludePalette, gNCM
+    gReserve, gVerbose, gCompress, gExcludePalette, gNCM = options
+
+
+def getOptions():
+    return (gReserve, gVerbose, gCompress, gExcludePalette, gNCM)
+
+
+def pngRowsToM65Rows(pngRows, colourMap):
     height = len(pngRows)
     width = len(pngRows[0])
     columnCount = width//8
     rowCount = height//8
     vprint("using", rowCount, "rows,", columnCount, "columns.")
-    m65Rows = []
-    for i in range(rowCount):
-        aRow = []
-        for b in range(columnCount):
-            aChar = bytearray()
-            for c in range(64):
-                aChar.append(0)
-            aRow.append(aChar)
-        m65Rows.append(aRow)
-    for currentRow in pngRows:
-        pngX = 0
-        for currentColumn in currentRow:
-            if gReserve:
-                currentColumn += 16
-            m65X = pngX//8
-            m65Y = pngY//8
-            m65Byte = ((pngX % 8)+(pngY*8)) % 64
-            m65Rows[m65Y][m65X][m65Byte] = currentColumn
-            pngX += 1
-        pngY += 1
-
-    imageData = bytearray()
-    for currentRow in m65Rows:
-        for currentColumn in currentRow:
-            imageData.extend(currentColumn)
+
+    # each 8 pixel wide slice of a png row becomes one 8 byte row
+    # inside a 64 byte character, so we can move whole slices at once.
+    imageData = bytearray(width*height)
+    rowSize = columnCount*64
+    for pngY in range(height):
+        currentRow = bytes(pngRows[pngY])
+        if colourMap:
+            currentRow = currentRow.translate(colourMap)
+        m65Pos = ((pngY//8)*rowSize)+((pngY % 8)*8)
+        for pngX in range(0, width, 8):
+            imageData[m65Pos:m65Pos+8] = currentRow[pngX:pngX+8]
+            m65Pos += 64
+    return imageData, rowCount, columnCount
+
+
+def pngRowsToNCMRows(pngRows, colourMap):
+    height = len(pngRows)
+    width = len(pngRows[0])
+    columnCount = width//16
+    rowCount = height//8
+    vprint("using", rowCount, "rows,", columnCount, "ncm columns.")
+
+    # two pixels per byte, left pixel in the low nybble. pairs are
+    # merged by or'ing the even and the shifted odd pixels as big ints.
+    colourMap = bytes(colourMap[i] % 16 for i in range(256))
+    shiftTable = bytes((i % 16)*16 for i in range(256))
+    imageData = bytearray(width*height//2)
+    rowSize = columnCount*64
+    for pngY in range(height):
+        currentRow = bytes(pngRows[pngY]).translate(colourMap)
+        lowNybbles = int.from_bytes(currentRow[0::2], "big")
+        highNybbles = int.from_bytes(
+            currentRow[1::2].translate(shiftTable), "big")
+        packedRow = (lowNybbles | highNybbles).to_bytes(width//2, "big")
+        m65Pos = ((pngY//8)*rowSize)+((pngY % 8)*8)
+        for packedX in range(0, width//2, 8):
+            imageData[m65Pos:m65Pos+8] = packedRow[packedX:packedX+8]
+            m65Pos += 64
     return imageData, rowCount, columnCount
 
 
+def ncmColourMap(rows, palette):
+    # map the (max. 16) colours used by the image to nybble values
+    used = set()
+    for currentRow in rows:
+        used.update(currentRow)
+    if len(used) > 16:
+        raise ConversionError("error: nibble colour mode needs <= 16 colours, "
+                              "but image uses "+str(len(used)), 3)
+    colourMap = bytearray(256)
+    ncmPalette = []
+    for idx in sorted(used):
+        colourMap[idx] = len(ncmPalette)
+        entry = palette[idx]
+        ncmPalette.append((entry[0], entry[1], entry[2]))
+    while len(ncmPalette) < 16:
+        ncmPalette.append((0, 0, 0))
+    return bytes(colourMap), ncmPalette
+
+
 def rle(data):
     outdata = []
     dsize = len(data)
@@ -135,83 +254,437 @@ def rle(data):
     return outdata
 
 
-####################### main program ########################
-
-# print(rle(["a", "b", "c", "c", "c", "d", "e"]))
-# exit(0)
-
-inputFileName, outputFileName = parseArgs()
+def writeFCI(outputFileName, numRows, numColumns, palette, imageData):
+    m65data = bytearray()
 
-vprint("### png2fci v"+gVersion+" ###")
-vprint("reading", inputFileName)
-pngReader = png.Reader(filename=inputFileName)
-pngData = pngReader.read()
-pngInfo = pngData[3]
+    vprint("building outfile")
+    m65data.extend(map(ord, 'fciP'))  # 0-3 : identifier bytes for format
+    m65data.append(0x01)  # 4 : version
+    m65data.append(numRows)  # 5 : number of rows
+    m65data.append(numColumns)  # 6 : number of columns
+    # 7 : options (b0: RLE compressed; b1: sys palette reserved;
+    #               b2: nibble colour mode)
+    m65data.append(gCompress+(2*gReserve)+(4*gNCM))
+    m65data.append(len(palette))  # 8 : palette size
 
-gWidth = pngInfo["size"][0]
-gHeight = pngInfo["size"][1]
-
-vprint("infile size is ", gWidth, "x", gHeight, "pixels")
-
-if (gWidth % 8 != 0 or gHeight % 8 != 0):
-    print("error: widht and height must be multiple of 8,")
-    print("but actual dimensions are ", gWidth, "x", gHeight)
-    exit(5)
+    for entry in palette:
+        m65data.extend(entry)
 
+    m65data.extend(map(ord, 'IMG'))
+
+    if gCompress:
+        m65data.extend(rle(imageData))
+    else:
+        m65data.extend(imageData)
+
+    outfile = open(outputFileName, "wb")
+    outfile.write(m65data)
+    outfile.close()
+    vprint("wrote", outputFileName)
+
+
+def readPNG(inputFileName):
+    vprint("reading", inputFileName)
+    pngReader = png.Reader(filename=inputFileName)
+    pngData = pngReader.read()
+    pngInfo = pngData[3]
+
+    width = pngInfo["size"][0]
+    height = pngInfo["size"][1]
+
+    vprint("infile size is ", width, "x", height, "pixels")
+
+    if (width % 8 != 0 or height % 8 != 0):
+        raise ConversionError("error: widht and height must be multiple of 8,\n"
+                              "but actual dimensions are " +
+                              str(width)+" x "+str(height), 5)
+
+    if gNCM and width % 16 != 0:
+        raise ConversionError("error: width must be multiple of 16 in nibble "
+                              "colour mode, but actual width is "+str(width), 5)
+
+    try:
+        palette = pngInfo["palette"]
+    except:
+        raise ConversionError("error: infile has no palette", 1)
+
+    return width, height, palette, list(pngData[2])
+
+
+def convertFile(inputFileName, outputFileName, colourMap=None):
+    width, height, palette, rows = readPNG(inputFileName)
+    vic4_palette = []
+
+    if gNCM:
+        # ncm images keep their 16 colours in the palette bank
+        # following the (optionally reserved) system colours
+        if colourMap is None:
+            colourMap, palette = ncmColourMap(rows, palette)
+    elif colourMap is None and gReserve:
+        colourMap = bytes((i+16) % 256 for i in range(256))
+
+    if gExcludePalette:
+        vprint("excluding palette data")
+    else:
+        if gReserve:
+            if len(palette) > 240:
+                raise ConversionError("error: can't reserve system palette because source PNG "
+                                      "has >240 palette entries.", 2)
+
+            # add placeholders for system colours
+            vprint("reserving system colour space")
+            for i in range(16):
+                vic4_palette.append((0, 0, 0))
+
+        for i in palette:
+            vic4_palette.append((i[0], i[1], i[2]))
+
+        vprint("outfile has", len(vic4_palette), "palette entries")
+
+    if gNCM:
+        imageData, numRows, numColumns = pngRowsToNCMRows(rows, colourMap)
+    else:
+        imageData, numRows, numColumns = pngRowsToM65Rows(rows, colourMap)
+    writeFCI(outputFileName, numRows, numColumns, vic4_palette, imageData)
+
+
+def unexpectedError(e):
+    # anything else a broken file can raise (png.FormatError, OSError, ...)
+    return "error: "+(str(e) or type(e).__name__)
+
+
+def scanColours(inputFileName):
+    # returns the palette entries actually used by an image and their
+    # pixel counts, keyed by their png palette index
+    try:
+        width, height, palette, rows = readPNG(inputFileName)
+    except ConversionError as e:
+        return inputFileName, None, str(e)
+    except Exception as e:
+        return inputFileName, None, unexpectedError(e)
+    pixels = b"".join(bytes(currentRow) for currentRow in rows)
+    colours = {}
+    for idx in sorted(set(pixels)):
+        if idx >= len(palette):
+            return inputFileName, None, "error: pixel index "+str(idx) + \
+                " is outside the palette ("+str(len(palette))+" entries)"
+        entry = palette[idx]
+        colours[idx] = ((entry[0], entry[1], entry[2]), pixels.count(idx))
+    return inputFileName, colours, None
+
+
+def medianCut(weights, count):
+    # split the box of colours with the widest channel range at its
+    # weighted median until there are count boxes, then use the
+    # weighted mean of each box
+    boxes = [list(weights)]
+    while len(boxes) < count:
+        widest = None
+        for i, box in enumerate(boxes):
+            if len(box) < 2:
+                continue
+            for channel in range(3):
+                values = [rgb[channel] for rgb in box]
+                spread = max(values)-min(values)
+                if widest is None or spread > widest[0]:
+                    widest = (spread, i, channel)
+        if widest is None:
+            break
+        spread, i, channel = widest
+        box = sorted(boxes[i], key=lambda rgb: rgb[channel])
+        half = sum(weights[rgb] for rgb in box)/2
+        split = 1
+        total = weights[box[0]]
+        while split < len(box)-1 and total < half:
+            total += weights[box[split]]
+            split += 1
+        boxes[i:i+1] = [box[:split], box[split:]]
+
+    palette = []
+    for box in boxes:
+        total = sum(weights[rgb] for rgb in box)
+        palette.append(tuple((sum(rgb[channel]*weights[rgb] for rgb in box)+total//2)//total
+                             for channel in range(3)))
+    return palette
+
+
+def nearestEntry(palette, rgb):
+    return min(range(len(palette)), key=lambda i:
+               (palette[i][0]-rgb[0])**2+(palette[i][1]-rgb[1])**2+(palette[i][2]-rgb[2])**2)
+
+
+def buildSharedPalette(scans):
+    # merge used colours of all images (in order of appearance),
+    # dropping duplicates, and build a translation table per image.
+    # if they don't fit, they are reduced to as many as fit.
+    firstEntry = 16 if gReserve else 0
+    lastEntry = firstEntry+16 if gNCM else 255
+    weights = {}
+    for inputFileName, colours in scans:
+        for rgb, count in colours.values():
+            weights[rgb] = weights.get(rgb, 0)+count
+
+    if len(weights) <= lastEntry-firstEntry:
+        sharedPalette = list(weights)
+        sharedIndex = {rgb: firstEntry+i for i, rgb in enumerate(sharedPalette)}
+        vprint("shared palette has", len(sharedPalette), "distinct colours")
+    else:
+        sharedPalette = medianCut(weights, lastEntry-firstEntry)
+        sharedIndex = {rgb: firstEntry+nearestEntry(sharedPalette, rgb) for rgb in weights}
+        print("warning: "+str(len(weights))+" distinct colours reduced to " +
+              str(len(sharedPalette)))
+
+    colourMaps = {}
+    for inputFileName, colours in scans:
+        colourMap = bytearray(256)
+        for idx, (rgb, count) in colours.items():
+            colourMap[idx] = sharedIndex[rgb]
+        colourMaps[inputFileName] = bytes(colourMap)
 
-try:
-    palette = pngInfo["palette"]
-except:
-    print("error: infile has no palette")
-    exit(1)
+    if gReserve:
+        sharedPalette = [(0, 0, 0)]*16 + sharedPalette
+    return sharedPalette, colourMaps
+
+
+def contentHash(fileName, extra=b""):
+    # options and tool version are part of the key, so changing
+    # either of them invalidates all cached conversions
+    h = hashlib.sha1()
+    h.update(repr((gVersion, gReserve, gCompress, gExcludePalette,
+                   gNCM)).encode())
+    h.update(extra)
+    with open(fileName, "rb") as f:
+        h.update(f.read())
+    return h.hexdigest()
+
+
+def batchWorker(job):
+    # report every failure, an exception escaping a worker would end
+    # the whole batch and lose the results of the other files
+    inputFileName, outputFileName, colourMap = job
+    try:
+        convertFile(inputFileName, outputFileName, colourMap)
+    except ConversionError as e:
+        return inputFileName, str(e)
+    except Exception as e:
+        return inputFileName, unexpectedError(e)
+    return inputFileName, None
+
+
+def batchConvert(outputDir, inputFileNames, paletteFileName=None):
+    cacheFileName = os.path.join(outputDir, gCacheFileName)
+    os.makedirs(outputDir, exist_ok=True)
+    try:
+        with open(cacheFileName, "r") as f:
+            cache = json.load(f)
+    except (OSError, ValueError):
+        cache = {}
+
+    processes = gJobs if gJobs > 0 else os.cpu_count()
+    pool = multiprocessing.Pool(processes, setOptions, (getOptions(),))
+    failed = 0
+
+    colourMaps = {}
+    paletteHash = b""
+    if paletteFileName:
+        scans = []
+        for inputFileName, colours, error in pool.imap(scanColours, inputFileNames):
+            if error:
+                print(inputFileName+":", error)
+                failed += 1
+            else:
+                scans.append((inputFileName, colours))
+        try:
+            sharedPalette, colourMaps = buildSharedPalette(scans)
+        except ConversionError as e:
+            print(e)
+            pool.close()
+            return failed+1
+        writeFCI(paletteFileName, 0, 0, sharedPalette, b"")
+        paletteHash = repr(sharedPalette).encode()
+        inputFileNames = [scan[0] for scan in scans]
+
+    jobs = []
+    hashes = {}
+    for inputFileName in inputFileNames:
+        baseName = os.path.splitext(os.path.basename(inputFileName))[0]
+        outputFileName = os.path.join(outputDir, baseName+".fci")
+        try:
+            hashes[inputFileName] = contentHash(inputFileName, paletteHash)
+        except OSError as e:
+            print(inputFileName+":", unexpectedError(e))
+            cache.pop(inputFileName, None)
+            failed += 1
+            continue
+        if cache.get(inputFileName) == hashes[inputFileName] and \
+                os.path.exists(outputFileName):
+            vprint("unchanged:", inputFileName)
+            continue
+        jobs.append((inputFileName, outputFileName,
+                     colourMaps.get(inputFileName)))
+
+    vprint(len(jobs), "of", len(inputFileNames), "files need conversion")
+
+    for inputFileName, error in pool.imap_unordered(batchWorker, jobs):
+        if error:
+            print(inputFileName+":", error)
+            cache.pop(inputFileName, None)
+            failed += 1
+        else:
+            cache[inputFileName] = hashes[inputFileName]
+    pool.close()
+    pool.join()
+
+    with open(cacheFileName, "w") as f:
+        json.dump(cache, f, indent=1, sort_keys=True)
+
+    return failed
+
+
+def naturalKey(fileName):
+    # frame10.png sorts after frame9.png
+    return [int(part) if part.isdigit() else part
+            for part in re.split(r"(\d+)", fileName)]
+
+
+def encodeDelta(screen, slots, target, columns):
+    # turns the displayed frame (screen: slot of each cell, slots:
+    # character data of each slot) into target and returns the delta.
+    # the player first changes screen indices, then writes characters,
+    # so a slot is only written when no other cell shows it.
+    oldScreen = list(screen)
+    changed = [i for i in range(len(target)) if slots[screen[i]] != target[i]]
+
+    if gIndexSwaps:
+        where = {}
+        for slot, char in enumerate(slots):
+            where.setdefault(char, slot)
+        for i in changed:
+            slot = where.get(target[i])
+            if slot is not None:
+                screen[i] = slot
+
+    refs = [0]*len(slots)
+    for slot in screen:
+        refs[slot] += 1
+    free = [slot for slot in range(len(slots)) if refs[slot] == 0]
+
+    writes = []
+    for i in changed:
+        slot = screen[i]
+        if slots[slot] == target[i]:
+            continue
+        if refs[slot] > 1:
+            # shared with other cells: move to an unused slot
+            refs[slot] -= 1
+            slot = free.pop()
+            refs[slot] = 1
+            screen[i] = slot
+        slots[slot] = target[i]
+        writes.append(slot)
+
+    swaps = [i for i in range(len(target)) if screen[i] != oldScreen[i]]
+    delta = bytearray(struct.pack("<HH", len(swaps), len(writes)))
+    for i in swaps:
+        delta.extend((i % columns, i//columns))
+        delta.extend(struct.pack("<H", screen[i]))
+    for slot in writes:
+        delta.extend(struct.pack("<H", slot))
+        delta.extend(slots[slot])
+
+    if [slots[slot] for slot in screen] != target:
+        raise ConversionError("internal error: delta doesn't reproduce frame", 6)
+    return delta, len(swaps), len(writes)
+
+
+def convertAnimation(outputFileName, inputFileNames):
+    inputFileNames = sorted(inputFileNames, key=naturalKey)
+    scans = []
+    for inputFileName in inputFileNames:
+        inputFileName, colours, error = scanColours(inputFileName)
+        if error:
+            raise ConversionError(inputFileName+": "+error, 1)
+        scans.append((inputFileName, colours))
+    palette, colourMaps = buildSharedPalette(scans)
+
+    frames = []
+    frameSize = None
+    for inputFileName in inputFileNames:
+        width, height, pngPalette, rows = readPNG(inputFileName)
+        if frameSize and frameSize != (width, height):
+            raise ConversionError("error: "+inputFileName+" is "+str(width)+" x " +
+                                  str(height)+" pixels, but the first frame is " +
+                                  str(frameSize[0])+" x "+str(frameSize[1]), 5)
+        frameSize = (width, height)
+        if gNCM:
+            imageData, numRows, numColumns = pngRowsToNCMRows(
+                rows, colourMaps[inputFileName])
+        else:
+            imageData, numRows, numColumns = pngRowsToM65Rows(
+                rows, colourMaps[inputFileName])
+        frames.append([bytes(imageData[i:i+64])
+                       for i in range(0, len(imageData), 64)])
+
+    if len(frames[0])*64 > 0xffff:
+        raise ConversionError("error: animation frames must have less than 1024 characters, "
+                              "but they have "+str(len(frames[0])), 5)
+
+    m65data = bytearray()
+    m65data.extend(map(ord, 'fcaP'))  # 0-3 : identifier bytes for format
+    m65data.append(0x01)  # 4 : version
+    m65data.append(numRows)  # 5 : number of rows
+    m65data.append(numColumns)  # 6 : number of columns
+    # 7 : options (b1: sys palette reserved; b2: nibble colour mode)
+    m65data.append((2*gReserve)+(4*gNCM))
+    m65data.append(len(palette))  # 8 : palette size
+    m65data.append(gFrameDelay)  # 9 : vertical blanks per frame
+    m65data.extend(struct.pack("<H", len(frames)))  # 10-11 : number of frames
+    for entry in palette:
+        m65data.extend(entry)
+    m65data.extend(map(ord, 'IMG'))
 
+    # keyframe: every cell shows its own slot
+    screen = list(range(len(frames[0])))
+    slots = list(frames[0])
+    m65data.extend(b"".join(slots))
 
-vic4_palette = []
+    # deltas to frames 1 .. n-1, then back to frame 0 for looping
+    for number, frame in enumerate(frames[1:]+frames[:1], 1):
+        delta, swaps, writes = encodeDelta(screen, slots, frame, numColumns)
+        vprint("frame", number % len(frames), ":", swaps, "index changes,",
+               writes, "characters,", len(delta), "bytes")
+        m65data.extend(delta)
 
-if gExcludePalette:
-    vprint("excluding palette data")
-else:
-    if gReserve:
-        if len(palette) > 240:
-            print("error: can't reserve system palette because source PNG "
-                  "has >240 palette entries.")
-            exit(2)
-
-        # add placeholders for system colours
-        vprint("reserving system colour space")
-        for i in range(16):
-            vic4_palette.append((0, 0, 0))
-
-    for i in palette:
-        vic4_palette.append((i[0], i[1], i[2]))
-
-    vprint("outfile has", len(vic4_palette), "palette entries")
-
-rows = list(pngData[2])
-imageData, numRows, numColumns = pngRowsToM65Rows(rows)
-m65data = bytearray()
-
-vprint("building outfile")
-m65data.extend(map(ord, 'fciP'))  # 0-3 : identifier bytes for format
-m65data.append(0x01)  # 4 : version
-m65data.append(numRows)  # 5 : number of rows
-m65data.append(numColumns)  # 6 : number of columns
-# 7 : options (b0: RLE compressed; b1: sys palette reserved)
-m65data.append(gCompress+(2*gReserve))
-m65data.append(len(vic4_palette))  # 8 : palette size
-
-if not gExcludePalette:
-    for entry in vic4_palette:
-        m65data.extend(entry)
+    outfile = open(outputFileName, "wb")
+    outfile.write(m65data)
+    outfile.close()
+    vprint("wrote", outputFileName, "("+str(len(frames)), "frames,",
+           len(m65data), "bytes)")
 
-m65data.extend(map(ord, 'IMG'))
 
-if gCompress:
-    m65data.extend(rle(imageData))
-else:
-    m65data.extend(imageData)
+####################### main program ########################
 
-outfile = open(outputFileName, "wb")
-outfile.write(m65data)
-vprint("done.")
-outfile.close()
+if __name__ == "__main__":
+    fileArgs = parseArgs()
+
+    vprint("### png2fci v"+gVersion+" ###")
+
+    if gAnimation:
+        try:
+            convertAnimation(fileArgs[0], fileArgs[1:])
+        except ConversionError as e:
+            print(e)
+            exit(e.code)
+    elif gSharedPalette:
+        if batchConvert(fileArgs[0], fileArgs[2:], fileArgs[1]):
+            exit(1)
+    elif gBatch:
+        if batchConvert(fileArgs[0], fileArgs[1:]):
+            exit(1)
+    else:
+        try:
+            convertFile(fileArgs[0], fileArgs[1])
+        except ConversionError as e:
+            print(e)
+            exit(e.code)
+        vprint("done.")